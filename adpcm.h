@@ -0,0 +1,79 @@
+/*
+ * File:   adpcm.h
+ * IMA-ADPCM sample playback from flash, 4 bits a sample
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef ADPCM_H
+#define	ADPCM_H
+/* Samples are recorded sounds converted by host/wav2adpcm.py into
+ * sample_bank.c, at the audio ISR rate. They are cut into blocks of
+ * ADPCM_BLOCK samples, each one
+ *   s16 predictor, u8 step index, u8 padding    decoder state before
+ *                                               the first sample
+ *   ADPCM_BLOCK/2 bytes                         4 bit codes, the first
+ *                                               sample in the low nibble
+ * so playback can start at any block, and a loop jumps back to the
+ * block of loop_start. The codes are standard IMA-ADPCM.
+ */
+
+#define ADPCM_BLOCK 64
+#define ADPCM_BLOCK_BYTES (4 + ADPCM_BLOCK/2)
+// a decoded sample of full scale, as the sine table's 1.0
+#define ADPCM_ONE ((_Accum)(1.0/32768))
+
+struct adpcm_sample {
+    const unsigned char *blocks;
+    unsigned int length;                // samples
+    unsigned int loop_start, loop_end;  // loop_end 0 plays it once;
+                                        // loop_start is on a block
+};
+
+// the samples compiled into flash
+extern const struct adpcm_sample sample_bank[];
+extern const int sample_bank_len;
+
+extern const short adpcm_steps[89];
+extern const signed char adpcm_index_step[16];
+
+// one playback of a sample
+struct adpcm_state {
+    unsigned int pos;                   // next sample
+    int predictor, index;
+};
+
+/* The next sample, -32768..32767; 0 after the end of a sample that
+ * does not loop. About 30 instructions, a block header every
+ * ADPCM_BLOCK samples. */
+static inline int adpcm_next(struct adpcm_state *st, const struct adpcm_sample *smp)
+{
+    const unsigned char *b;
+    int code, step, diff;
+    if (smp->loop_end) {
+        if (st->pos >= smp->loop_end) st->pos = smp->loop_start;
+    } else if (st->pos >= smp->length) {
+        return 0;
+    }
+    b = smp->blocks + (st->pos/ADPCM_BLOCK)*ADPCM_BLOCK_BYTES;
+    if (st->pos % ADPCM_BLOCK == 0) {
+        st->predictor = (short)(b[0] | b[1] << 8);
+        st->index = b[2];
+    }
+    code = b[4 + (st->pos % ADPCM_BLOCK)/2] >> ((st->pos & 1)*4) & 0xf;
+    step = adpcm_steps[st->index];
+    diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    st->predictor += (code & 8)? -diff : diff;
+    if (st->predictor > 32767) st->predictor = 32767;
+    else if (st->predictor < -32768) st->predictor = -32768;
+    st->index += adpcm_index_step[code];
+    if (st->index < 0) st->index = 0;
+    else if (st->index > 88) st->index = 88;
+    st->pos++;
+    return st->predictor;
+}
+
+#endif	/* ADPCM_H */
@@ -12,17 +12,21 @@
 #include "config_1_3_2.h"            // clock AND protoThreads configure!
 #include "pt_cornell_1_3_2_python.h" // threading library
 #include "port_expander_brl4.h"      // yup, the expander
+#include "spi2_bus.h"                // SPI2 shared by the DAC and the expander
+#include "pe_keys.h"                 // debounced keys on the expander
+#include "isr_prof.h"                // ISR execution time stats
+#include "serial_frame.h"            // binary frames on the UART
+#include "scene.h"                   // sources and map, from a scene blob
+#include "adpcm.h"                   // recorded voices
+#include "reverb.h"                  // street ambience
+#include "noise.h"                   // noise voices
+#include "contour.h"                 // breakpoint voices
 #include "tft_master.h"              // graphics libraries, SPI channel 1 connections to TFT
 #include "tft_gfx.h"
 #include <stdlib.h>                  // need for rand function
 #include <math.h>                    // need for sine function
 #include <stdfix.h>                  // The fixed point types
-
-////////////////////////////////////
-// lock out timer interrupt during spi comm to port expander
-// This is necessary if you use the SPI2 channel in an ISR
-#define start_spi2_critical_section INTEnable(INT_T2, 0);
-#define end_spi2_critical_section INTEnable(INT_T2, 1);
+#include "spsc_queue.h"              // ISR <-> thread queues and parameter blocks
 
 // string buffer for print statement
 char buffer[60];
@@ -34,220 +38,440 @@ char buffer[60];
 #define Fs 44000.0 // audio sample frequency
 #define two32 4294967296.0 // 2^32, constant for setting DDS frequency
 float DDS_constant = 4294967296.0/44000.0; // precomputed constant for DDS increment
+// the DDS increment of 1 Hz at the rate Timer2 really runs at, about
+// 23988 Hz: the FM and contour voices sound at the frequencies the
+// scene and contour bank give, the chirp, ramp and tones voices keep
+// the lab's Fs above
+#define DDS_HZ (two32*(SAMPLE_PERIOD + 1)/(pb_clock))
 // sine lookup table for DDS
 #define sine_table_size 256
 volatile _Accum sine_table[sine_table_size] ;
-// phase accumulator for DDS
-volatile unsigned int DDS_phase_left;
-volatile unsigned int DDS_phase_right;
-volatile unsigned int car_phase_left;
-volatile unsigned int car_phase_right;
-volatile unsigned int bell_phase_left;
-volatile unsigned int bell_phase_right;
 
+// sound sources, and the two ears each source is synthesized for;
+// a scene fills the slots, named here after the default scene
+#define NUM_SOURCES SCENE_SOURCES_MAX
+#define BIRD 0
+#define CAR  1
+#define BELL 2
+#define LEFT_EAR  0
+#define RIGHT_EAR 1
+// phase accumulator for DDS
+volatile unsigned int DDS_phase[NUM_SOURCES][2];
 // synthesized frequency of the audios
-volatile float Fout_left; 
-volatile float Fout_right; 
-volatile float Fout_car_left;
-volatile float Fout_car_right;
-volatile float Fout_bell_left;
-volatile float Fout_bell_right;
+volatile float Fout[NUM_SOURCES][2];
 // phase increment to set the frequency DDS_increment = Fout*two32/Fs;
-volatile unsigned int DDS_increment_left;
-volatile unsigned int DDS_increment_right;
-volatile unsigned int car_increment_left;
-volatile unsigned int car_increment_right;
-volatile unsigned int bell_increment_left;
-volatile unsigned int bell_increment_right;
-// global max: for intensity ratio tuning
-volatile _Accum global_max_amplitude = 12;
-volatile _Accum global_max_bell_amplitude = 18;
-volatile _Accum global_max_car_amplitude = 180;
-// max: for amplitude difference tuning
-volatile _Accum max_amplitude=12;
-volatile _Accum max_amplitude_left=12; 
-volatile _Accum max_amplitude_right=12;
-volatile _Accum max_bell_amplitude=18;
-volatile _Accum max_bell_amplitude_left=18; 
-volatile _Accum max_bell_amplitude_right=18;
-volatile _Accum max_car_amplitude=180;
-volatile _Accum max_car_amplitude_left=180; 
-volatile _Accum max_car_amplitude_right=180;
-// threshold values
-volatile _Accum threshold_amplitude=0;
-volatile _Accum bell_threshold_amplitude=0;
-// waveform amplitude envelope parameters (determines the length of the audio)
-volatile unsigned int attack_time_left=1000, decay_time_left=1000, sustain_time_left=3720; 
-volatile unsigned int attack_time_right=1000, decay_time_right=1000, sustain_time_right=3720; 
-volatile unsigned int bell_attack_time_left=2000, bell_decay_time_left=6000, bell_sustain_time_left=10000; 
-volatile unsigned int bell_attack_time_right=2000, bell_decay_time_right=6000, bell_sustain_time_right=10000;
-volatile unsigned int car_attack_time_left=1428, car_decay_time_left=1428, car_sustain_time_left=0; 
-volatile unsigned int car_attack_time_right=1428, car_decay_time_right=1428, car_sustain_time_right=0;
-// current amplitude of the audios
-volatile _Accum current_amplitude_left;
-volatile _Accum current_amplitude_right;
-volatile _Accum current_bell_amplitude_left;
-volatile _Accum current_bell_amplitude_right;
-volatile _Accum current_car_amplitude_left;
-volatile _Accum current_car_amplitude_right;
-// amplitude change per sample during attack and decay
-// no change during sustain
-volatile _Accum attack_inc_left, decay_inc_left ;
-volatile unsigned int note_time_left;
-volatile _Accum attack_inc_right, decay_inc_right ;
-volatile unsigned int note_time_right;
-volatile _Accum car_attack_inc_left, car_decay_inc_left ;
-volatile unsigned int car_note_time_left;
-volatile _Accum car_attack_inc_right, car_decay_inc_right ;
-volatile unsigned int car_note_time_right;
-volatile _Accum bell_attack_inc_left, bell_decay_inc_left ;
-volatile unsigned int bell_note_time_left;
-volatile _Accum bell_attack_inc_right, bell_decay_inc_right ;
-volatile unsigned int bell_note_time_right;
-volatile _Accum bell_sustain_inc_left, bell_sustain_inc_right;
+volatile unsigned int DDS_increment[NUM_SOURCES][2];
+// A source on a path is synthesized for its near ear only. Its far ear
+// hears the near one from a short delay line, later by the ITD and
+// quieter by the ILD, and both glide toward what the motion thread
+// publishes: the gain ILD_STEP at most a sample, the delay a sample
+// every ITD_BLOCK. A press sets them at once. The line is indexed by
+// refl_pos, so ITD_LINE divides REFL_LINE -- owned by the Timer2 ISR
+#define ITD_LINE 32                 // samples, over the widest ITD
+#define ITD_BLOCK 64
+#define ILD_STEP ((_Accum)(1.0/2048))
+static _Accum itd_line[NUM_SOURCES][ITD_LINE];
+static unsigned int itd_now[NUM_SOURCES];
+static _Accum ild_now[NUM_SOURCES];
+// the far ear the ISR plays each source with, taken from the published
+// far_ear only when the near ear starts a note, so a new one never
+// lands mid-note -- owned by the Timer2 ISR
+static int far_now[NUM_SOURCES];
+// the scene: where the sources are, how they sound and fade with
+// distance, their envelopes, and the map -- see scene.h
+struct scene scene;
+
+// amplitude envelope of one source in one ear -- owned by the Timer2 ISR
+struct envelope {
+    _Accum current;              // current amplitude of the audio
+    _Accum attack_inc, decay_inc; // change per sample during attack and decay
+    unsigned int note_time;      // samples since the note started
+};
+volatile struct envelope env[NUM_SOURCES][2];
+// playback of the sample voices, per ear -- owned by the Timer2 ISR
+static struct adpcm_state sample_play[NUM_SOURCES][2];
+// and of the noise voices
+static struct noise_state noise_play[NUM_SOURCES][2];
+
+// FM voices: the carrier's phase is DDS_phase, moved by the index times
+// the sine of a modulator; one more DDS and table lookup, no float math
+// in the ISR. The index is in 1/4096 turns so index*sine, shifted up by
+// FM_PHASE_SHIFT, is a phase.
+struct fm_voice {
+    unsigned int carrier_inc, mod_inc;  // DDS increments
+    _Accum index, index_step;       // at the note start, and a sample
+    unsigned int index_end;         // samples the index changes for
+};
+#define FM_INDEX_ONE (4096/6.2831853) // one radian
+#define FM_PHASE_SHIFT 20
+// modulator phase and index, per ear -- owned by the Timer2 ISR
+static unsigned int fm_phase[NUM_SOURCES][2];
+static _Accum fm_index[NUM_SOURCES][2];
+// contour voices: where each ear is on the pitch and level breakpoints
+// -- owned by the Timer2 ISR
+static struct contour_state pitch_play[NUM_SOURCES][2], level_play[NUM_SOURCES][2];
+// waveform of each source in each ear this sample, -1..1
+static _Accum wave[NUM_SOURCES][2];
+
+// === air absorption ================================================
+// Air takes more of the high frequencies of a sound the further it
+// goes, so far away traffic should sound duller as well as quieter.
+// The waveform of each source goes through a one-pole low-pass in both
+// ears, y += k*(x - y), before the envelope. spatial_update looks k up
+// from the distance, nothing is worked out per sample. The cutoff
+// halves every 100 pixels from Fs/2 at the source,
+// fc = Fs/2*2^(-d/100) and k = 1 - exp(-2*pi*fc/Fs), at the near end
+// of each AIR_BIN_PX bin; bin 0 passes everything. The state is
+// _Accum, 15 fractional bits on the PIC32.
+#define AIR_BINS 16
+#define AIR_BIN_PX 25
+static const unsigned short air_q15[AIR_BINS] = {
+    32768, 30434, 29214, 27708, 25956, 24022, 21977, 19891,
+    17828, 15839, 13964, 12226, 10642,  9215,  7945,  6824
+};
+// the filter passing everything
+#define AIR_OPEN ((_Accum)1)
+// host_sim -g turns it off, the notebook model has no air
+int air_absorption_on = 1;
+// filtered waveform of each source in each ear -- owned by the Timer2 ISR
+static _Accum air_y[NUM_SOURCES][2];
+
+// === head shadow ===================================================
+// The head stops the high frequencies of a source on the far side more
+// than the low ones. The far ear of each source goes through a one-pole
+// low-pass, y += k*(x - y), whose k falls with the source's azimuth:
+// the cutoff drops from Fs/2 straight ahead (bin 0 passes everything)
+// to 700 Hz at the side, as Fs/2*(700/(Fs/2))^sin(azimuth), and
+// k = 1 - exp(-2*pi*fc/Fs). The cos(azimuth) gain stays, it is the
+// broadband part of the shadow. When the bin changes k moves to the
+// new value over HS_FADE samples instead of stepping.
+#define HS_BINS 16                  // 6 degrees each, 0 to 90
+#define HS_FADE 64
+#define HS_BIN_RAD (1.5707963/(HS_BINS - 1))
+static const unsigned short head_shadow_q15[HS_BINS] = {
+    32768, 29594, 27018, 23889, 20583, 17428, 14630, 12275,
+    10368,  8865,  7711,  6847,  6225,  5808,  5568,  5489
+};
+// the filter passing everything
+#define HS_OPEN ((_Accum)1)
+// host_sim -g turns it off, the notebook model has no head shadow
+int head_shadow_on = 1;
+
+// filter of one source's far ear -- owned by the Timer2 ISR
+struct shadow {
+    _Accum y;                       // output, DAC codes
+    _Accum k, step, target;
+    int fade;                       // samples until k is at target
+};
+static struct shadow shadow[NUM_SOURCES];
+
+static inline _Accum head_shadow(struct shadow *h, _Accum target, _Accum x)
+{
+    if (target != h->target) {
+        h->target = target;
+        h->step = (target - h->k)*(_Accum)(1.0/HS_FADE);
+        h->fade = HS_FADE;
+    }
+    if (h->fade) h->k = (--h->fade)? h->k + h->step : h->target;
+    // open: no multiply, and no rounding on the way through
+    if (h->k == HS_OPEN) h->y = x;
+    else h->y += h->k*(x - h->y);
+    return h->y;
+}
+
+// === early reflections =============================================
+// The buildings reflect what they do not let through. Each source is
+// also heard from its images in the walls of the scene's occluding
+// rectangles, the nearest REFL_TAPS that scene_reflections finds. The
+// near ear of every source goes into a delay line, scaled so that
+// REFL_ONE is the peak of its envelope, 8 bits a sample; each image is
+// a tap on the line, late by the extra length of its path, at the peak
+// the source's own attenuation curve gives at the image's distance
+// times REFL_WALL. Its far ear tap is later still by the image's ITD
+// and quieter by its amplitude ratio. spatial_update works the taps
+// out, the ISR reads and multiplies.
+#define REFL_TAPS 4
+#define REFL_LINE 1024              // samples, a power of 2: 43 ms
+#define REFL_ONE 120                // envelope peak, below 127 for overshoot
+#define REFL_WALL 0.7               // amplitude a wall sends back
+// host_sim -g turns it off, the notebook model has no walls
+int reflections_on = 1;
+struct reflection_tap {
+    unsigned int delay[2];          // per ear, samples
+    _Accum gain[2];                 // per ear, DAC codes per line step
+};
+// the delay line of each source -- owned by the Timer2 ISR
+static signed char refl_line[NUM_SOURCES][REFL_LINE];
+static unsigned int refl_pos;
+
+// === ambience ======================================================
+// The near ear of every source is also sent to the reverb of reverb.h,
+// more of it the further away the source is: the direct sound falls
+// with distance, the street around the listener does much less. The
+// send is REVERB_SEND*d/(d + REVERB_NEAR_PX), worked out in
+// spatial_update; the tail goes into both DAC channels.
+#define REVERB_SEND 0.35
+#define REVERB_NEAR_PX 100
+// host_sim -g turns it off, the notebook model has no street
+int reverb_on = 1;
+
+//== ISR <-> thread communication ===========================================
+// everything the audio ISRs need for one listener position; computed by
+// the timer thread and published to the ISRs in one store
+struct source_params {
+    int far_ear;                    // ear that hears the source late and quieter
+    _Accum threshold;               // amplitude when the note is over
+    _Accum attack_inc[2], decay_inc[2]; // per ear
+    // envelope in samples from the note start, from the scene
+    unsigned int attack_end, sustain_end, decay_end, note_length;
+    struct scene_voice voice;
+    struct noise_voice noise;       // a VOICE_NOISE voice, for the ISR
+    struct fm_voice fm;             // a VOICE_FM one
+    _Accum shadow;                  // far ear head shadow coefficient
+    _Accum air;                     // air absorption coefficient, both ears
+    _Accum refl_scale;              // near ear to delay line, REFL_ONE/peak
+    int taps;
+    struct reflection_tap tap[REFL_TAPS];
+    _Accum reverb_send;             // near ear to the reverb
+    float dds_constant;             // DDS_constant, times the Doppler factor
+    unsigned int contour_inc;       // DDS_HZ, times it and rounded
+    // each note loop reloads the slopes; the far ear of a source on a
+    // path is its near ear itd_samples late and ild as loud
+    int moving;
+    unsigned int itd_samples;
+    _Accum ild;
+};
+struct spatial_params {
+    struct source_params src[NUM_SOURCES];
+};
+DBUF(struct spatial_params) spatial;
+
+// note-on event: source and ear packed into one queue word
+#define NOTE_ON(source, ear) (((source) << 1) | (ear))
+#define NOTE_SOURCE(ev) ((ev) >> 1)
+#define NOTE_EAR(ev) ((ev) & 1)
+// timer thread -> Timer2: start the near ear now
+SPSC_QUEUE(near_queue, 8);
+// Timer3/4/5 -> Timer2: start the far ear after the ITD
+// (all three are ipl1 so they never preempt each other: one producer)
+SPSC_QUEUE(far_queue, 8);
+// Timer2 -> timer thread: far ear notes that actually started
+SPSC_QUEUE(started_queue, 16);
+// longest time Timer2 spent on the queues, in core timer ticks
+volatile unsigned int queue_ticks_max;
+
+// fixed point conversions
+#define float2Accum(a) ((_Accum)(a))
+#define Accum2float(a) ((float)(a))
+#define int2Accum(a) ((_Accum)(a))
+#define Accum2int(a) ((int)(a))
 
 //== position control ===========================================
 #define head_radius 9 
 #define sound_speed 34000
+// map scale: the roads are 8 m wide
+#define MAP_CM_PER_PX 10
 volatile int map_update = 0;
-// for debugging purpose
-volatile int timer3_counter = 0; // bird
-volatile int timer4_counter = 0; // car
-volatile int timer5_counter = 0; // bell
-// audio delay of the further channel
-volatile double delay, bell_delay, car_delay;
-volatile int timer3_delay, timer4_delay, timer5_delay;
-// hardcoded sound source position
-volatile int bird_x, bird_y, car_x, car_y, bell_x, bell_y;
-// distance between "human" and sound sources
-volatile int x_diff, bell_x_diff, car_x_diff;
-volatile int y_diff, bell_y_diff, car_y_diff;
-// intermediate values for spatial audio calculation
-volatile double tan_value, bell_tan_value, car_tan_value;
-volatile double angle_rad, bell_angle_rad, car_angle_rad;
-volatile double intensity_diff, bell_intensity_diff, car_intensity_diff;
-volatile double amplitude_ratio, bell_amplitude_ratio, car_amplitude_ratio;
-// flag indecating whether audio source on the left or right
-volatile int left, bell_left, car_left;
-// counter for bell's two-note audio synthesis
-volatile int bell_counter;
-// hardcoded initial "human" position
-static _Accum xpos=int2Accum(120), ypos=int2Accum(310);
+// for debugging purpose: far ear notes started, per source
+int far_note_count[NUM_SOURCES];
+// per source, for the current listener position
+volatile double source_ratio[NUM_SOURCES]; // far/near amplitude ratio
+volatile int source_itd[NUM_SOURCES];      // far ear delay in timer counts (Timer3/4/5)
+volatile _Accum source_peak[NUM_SOURCES];  // near ear peak amplitude
+// "human" position, starts where the scene says
+static _Accum xpos, ypos;
 
 //== Timer 2 interrupt handler ===========================================
 volatile unsigned int DAC_data_A, DAC_data_B ;// audio output values
 volatile SpiChannel spiChn = SPI_CHANNEL2 ;	// the SPI channel to use
 volatile int spiClkDiv = 4 ; // 10 MHz max speed for port expander!!
+// DAC output range of each ear since the last telemetry frame; the
+// telemetry thread reads and clears it with interrupts off
+struct dac_peak { unsigned int min[2], max[2]; };
+static struct dac_peak dac_peak = {{4095, 4095}, {0, 0}};
 
-#define float2Accum(a) ((_Accum)(a))
-#define Accum2float(a) ((float)(a))
-#define int2Accum(a) ((_Accum)(a))
-#define Accum2int(a) ((int)(a))
+// load the published envelope slopes into one ear and restart its note
+// -- Timer2 ISR only
+static inline void start_note(unsigned int ev)
+{
+    int s = NOTE_SOURCE(ev), ear = NOTE_EAR(ev);
+    struct source_params *p = &DBUF_FRONT(spatial)->src[s];
+    env[s][ear].attack_inc = p->attack_inc[ear];
+    env[s][ear].decay_inc = p->decay_inc[ear];
+    // set note time to 0 to enable audio
+    env[s][ear].note_time = 0;
+}
+
+// frequency of a voice t samples into its note -- Timer2 ISR only
+static inline float voice_frequency(const struct scene_voice *v, unsigned int t)
+{
+    switch (v->type) {
+    case VOICE_CHIRP:
+        return v->u.chirp.f0 + v->u.chirp.sweep*((float)t*t);
+    case VOICE_RAMP:
+        t %= v->u.ramp.period;
+        return (t < v->u.ramp.period/2)? v->u.ramp.rise*t + v->u.ramp.rise0 :
+            v->u.ramp.fall*t + v->u.ramp.fall0;
+    case VOICE_TONES:
+        return (t < v->u.tones.t1)? v->u.tones.f1 : (t < v->u.tones.t2)? v->u.tones.f2 : 0;
+    default:
+        return 0;
+    }
+}
+
+// === ISR profiler ================================================
+// Timer2 period in peripheral clocks: the budget of one audio sample
+#define SAMPLE_PERIOD 2667
+// scene_load holds scenes to it, in cpu cycles; pb_clock is sys_clock
+#if SAMPLE_PERIOD != SCENE_ISR_BUDGET
+#error "SCENE_ISR_BUDGET in scene.h must be the Timer2 period"
+#endif
+// Timer2 entered more than a quarter period after its match counts as late
+#define SAMPLE_LATE (SAMPLE_PERIOD/4)
+enum { PROF_T2, PROF_T3, PROF_T4, PROF_T5, PROF_INT2, PROF_VECTORS };
+static const char *prof_name[PROF_VECTORS] = {"T2", "T3", "T4", "T5", "INT2"};
+static struct isr_prof isr_prof[PROF_VECTORS];
 
 void __ISR(_TIMER_2_VECTOR, ipl2) Timer2Handler(void)
 {
-    int junk;
+    ISR_PROF_ENTER();
+    int junk, s, ear, far, t, wet[2], restart = 0;
+    _Accum out[2], send, d;
+    const signed char *line;
+    const struct reflection_tap *tap;
+    const struct fm_voice *fm;
+    const struct contour_voice *cv;
+    unsigned int ev, queue_ticks;
+    struct spatial_params *sp;
+    volatile struct envelope *e;
     mT2ClearIntFlag();
+    // TMR2 counts up from the period match that raised this interrupt
+    ISR_PROF_LATENCY(&isr_prof[PROF_T2], TMR2, SAMPLE_LATE);
     
-    // bird audio frequenct
-    Fout_left = (0.000153)*(note_time_left*note_time_left) + 2000;
-    Fout_right = (0.000153)*(note_time_right*note_time_right) + 2000;
-    // car audio frequenct
-    int temp_left = car_note_time_left % 714;
-    int temp_right = car_note_time_right % 714;
-    if (temp_left < 357) Fout_car_left = 0.9014*temp_left + 0.3;
-    else Fout_car_left = 1.3-0.0014*temp_left;
-    if (temp_right < 357) Fout_car_right = 0.9014*temp_right + 0.3;
-    else Fout_car_right = 1.3-0.0014*temp_right;
-    // bell audio frequenct
-    if (bell_note_time_left < 4500) Fout_bell_left = 2093;
-    else if (bell_note_time_left < 9000) Fout_bell_left = 1661;
-    else Fout_bell_left = 0;
-    if (bell_note_time_right < 4500) Fout_bell_right = 2093;
-    else if (bell_note_time_right < 9000) Fout_bell_right = 1661;
-    else Fout_bell_right = 0;
-    
-    // direct digital synthesis calculation
-    DDS_increment_left = (unsigned int)(Fout_left*DDS_constant);     
-    DDS_phase_left += DDS_increment_left;
-    car_increment_left = (unsigned int)(Fout_car_left*DDS_constant);
-    car_phase_left += car_increment_left;      
-    bell_increment_left = (unsigned int)(Fout_bell_left*DDS_constant);
-    bell_phase_left += bell_increment_left;
-    // DAC output: sum of all three synthesized audios
-    DAC_data_A = (int)(current_amplitude_left*sine_table[DDS_phase_left>>24]) 
-            + (int)(current_car_amplitude_left*sine_table[car_phase_left>>24])
-            + (int)(current_bell_amplitude_left*sine_table[bell_phase_left>>24]) + 2048; 
-    
-    // direct digital synthesis calculation
-    DDS_increment_right = (unsigned int)(Fout_right*DDS_constant);     
-    DDS_phase_right += DDS_increment_right; 
-    car_increment_right = (unsigned int)(Fout_car_right*DDS_constant);
-    car_phase_right += car_increment_right;              
-    bell_increment_right = (unsigned int)(Fout_bell_right*DDS_constant);
-    bell_phase_right += bell_increment_right;
-    // DAC output: sum of all three synthesized audios
-    DAC_data_B = (int)(current_amplitude_right*sine_table[DDS_phase_right>>24]) 
-            + (int)(current_car_amplitude_right*sine_table[car_phase_right>>24]) 
-            + (int)(current_bell_amplitude_right*sine_table[bell_phase_right>>24]) + 2048; 
-    
-    // bird sound amplitude tuning
-    if (note_time_left < (attack_time_left + decay_time_left + sustain_time_left)){
-        current_amplitude_left = (note_time_left <= attack_time_left)? 
-            current_amplitude_left + attack_inc_left : 
-            (note_time_left <= attack_time_left + sustain_time_left)? current_amplitude_left:
-                current_amplitude_left - decay_inc_left;
-    } else { 
-        current_amplitude_left = threshold_amplitude; // no sound
+    // start the notes queued by the timer thread and the delay ISRs
+    queue_ticks = ReadCoreTimer();
+    while (spsc_get(&near_queue, &ev)) {
+        start_note(ev);
+        s = NOTE_SOURCE(ev);
+        far_now[s] = !NOTE_EAR(ev);
+        itd_now[s] = DBUF_FRONT(spatial)->src[s].itd_samples;
+        ild_now[s] = DBUF_FRONT(spatial)->src[s].ild;
     }
-    if (note_time_right < (attack_time_right + decay_time_right + sustain_time_right)){
-        current_amplitude_right = (note_time_right <= attack_time_right)? 
-            current_amplitude_right + attack_inc_right : 
-            (note_time_right <= attack_time_right + sustain_time_right)? current_amplitude_right:
-                current_amplitude_right - decay_inc_right;
-    } else { 
-        current_amplitude_right = threshold_amplitude; // no sound
+    while (spsc_get(&far_queue, &ev)) {
+        // the far ear of the note playing, whatever was published since
+        ev = NOTE_ON(NOTE_SOURCE(ev), far_now[NOTE_SOURCE(ev)]);
+        start_note(ev);
+        spsc_put(&started_queue, ev);
     }
+    // one consistent parameter set for this sample
+    sp = DBUF_FRONT(spatial);
+    queue_ticks = ReadCoreTimer() - queue_ticks;
+    if (queue_ticks > queue_ticks_max) queue_ticks_max = queue_ticks;
     
-    // bell sound amplitude tuning
-    if (bell_note_time_left < (bell_attack_time_left + bell_decay_time_left + bell_sustain_time_left)){
-        current_bell_amplitude_left = (bell_note_time_left <= bell_attack_time_left)? 
-            current_bell_amplitude_left + bell_attack_inc_left : 
-            (bell_note_time_left <= bell_attack_time_left + bell_sustain_time_left)? current_bell_amplitude_left:
-                current_bell_amplitude_left - bell_decay_inc_left;
-    } else { 
-        current_bell_amplitude_left = bell_threshold_amplitude; // no sound
-    }
-    if (bell_note_time_right < (bell_attack_time_right + bell_decay_time_right + bell_sustain_time_right)){
-        current_bell_amplitude_right = (bell_note_time_right <= bell_attack_time_right)? 
-            current_bell_amplitude_right + bell_attack_inc_right : 
-            (bell_note_time_right <= bell_attack_time_right + bell_sustain_time_right)? current_bell_amplitude_right:
-                current_bell_amplitude_right - bell_decay_inc_right;
-    } else { 
-        current_bell_amplitude_right = bell_threshold_amplitude; // no sound
+    for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++) {
+        for (s = 0; s < NUM_SOURCES; s++) {
+            // a moving source's far ear is its near one, delayed
+            if (sp->src[s].moving && ear == far_now[s]) continue;
+            // a recording plays from its start with every note
+            if (sp->src[s].voice.type == VOICE_SAMPLE) {
+                if (env[s][ear].note_time == 0) sample_play[s][ear].pos = 0;
+                wave[s][ear] = (_Accum)adpcm_next(&sample_play[s][ear],
+                    sp->src[s].voice.u.sample.sample) * ADPCM_ONE;
+            } else if (sp->src[s].voice.type == VOICE_NOISE) {
+                wave[s][ear] = (_Accum)noise_next(&noise_play[s][ear], &sp->src[s].noise,
+                    env[s][ear].note_time) * NOISE_ONE;
+            } else if (sp->src[s].voice.type == VOICE_FM) {
+                // both operators and the index start over with every note
+                fm = &sp->src[s].fm;
+                if (env[s][ear].note_time == 0) {
+                    DDS_phase[s][ear] = fm_phase[s][ear] = 0;
+                    fm_index[s][ear] = fm->index;
+                } else if (env[s][ear].note_time < fm->index_end) {
+                    fm_index[s][ear] += fm->index_step;
+                }
+                fm_phase[s][ear] += fm->mod_inc;
+                DDS_phase[s][ear] += fm->carrier_inc;
+                wave[s][ear] = sine_table[(DDS_phase[s][ear] +
+                    ((unsigned int)(int)(sine_table[fm_phase[s][ear]>>24]*fm_index[s][ear]) << FM_PHASE_SHIFT)) >> 24];
+            } else if (sp->src[s].voice.type == VOICE_CONTOUR) {
+                // both contours start over with every note; the pitch
+                // times the increment of 1 Hz, no float math
+                cv = sp->src[s].voice.u.contour.voice;
+                if (env[s][ear].note_time == 0) {
+                    contour_start(&pitch_play[s][ear]);
+                    contour_start(&level_play[s][ear]);
+                }
+                DDS_phase[s][ear] += (unsigned int)((unsigned long long)(unsigned int)
+                    contour_next(&pitch_play[s][ear], &cv->pitch)*sp->src[s].contour_inc >> CONTOUR_SHIFT);
+                wave[s][ear] = sine_table[DDS_phase[s][ear]>>24] *
+                    ((_Accum)(contour_next(&level_play[s][ear], &cv->level) >> 1) * CONTOUR_LEVEL_ONE);
+            } else {
+                // direct digital synthesis calculation
+                // audio frequency, from the voice the scene gives the source
+                Fout[s][ear] = voice_frequency(&sp->src[s].voice, env[s][ear].note_time);
+                DDS_increment[s][ear] = (unsigned int)(Fout[s][ear]*sp->src[s].dds_constant);
+                DDS_phase[s][ear] += DDS_increment[s][ear];
+                wave[s][ear] = sine_table[DDS_phase[s][ear]>>24];
+            }
+            // air absorption; open, no multiply
+            if (sp->src[s].air == AIR_OPEN) air_y[s][ear] = wave[s][ear];
+            else air_y[s][ear] += sp->src[s].air*(wave[s][ear] - air_y[s][ear]);
+        }
     }
-    
-    // car sound amplitude tuning
-    if (car_note_time_left < (car_attack_time_left + car_decay_time_left + car_sustain_time_left)){
-        current_car_amplitude_left = (car_note_time_left <= car_attack_time_left)? 
-            current_car_amplitude_left + car_attack_inc_left : 
-            (car_note_time_left <= car_attack_time_left + car_sustain_time_left)? current_car_amplitude_left:
-                current_car_amplitude_left - car_decay_inc_left;
-    } else { 
-        current_car_amplitude_left = threshold_amplitude; // no sound
+    // DAC output: sum of all three synthesized audios, the far ear of
+    // each through its head shadow
+    DAC_data_A = DAC_data_B = 2048;
+    send = 0;
+    for (s = 0; s < NUM_SOURCES; s++) {
+        far = far_now[s];
+        out[!far] = env[s][!far].current*air_y[s][!far];
+        if (sp->src[s].moving) {
+            itd_line[s][refl_pos & (ITD_LINE - 1)] = out[!far];
+            d = sp->src[s].ild - ild_now[s];
+            ild_now[s] += (d > ILD_STEP)? ILD_STEP : (d < -ILD_STEP)? -ILD_STEP : d;
+            out[far] = ild_now[s]*itd_line[s][(refl_pos - itd_now[s]) & (ITD_LINE - 1)];
+        } else {
+            out[far] = env[s][far].current*air_y[s][far];
+        }
+        out[far] = head_shadow(&shadow[s], sp->src[s].shadow, out[far]);
+        send += out[!far]*sp->src[s].reverb_send;
+        // early reflections: taps on the source's delay line
+        line = refl_line[s];
+        refl_line[s][refl_pos] = (signed char)(int)(out[!far]*sp->src[s].refl_scale);
+        for (t = 0, tap = sp->src[s].tap; t < sp->src[s].taps; t++, tap++) {
+            out[LEFT_EAR] += tap->gain[LEFT_EAR]*line[(refl_pos - tap->delay[LEFT_EAR]) & (REFL_LINE - 1)];
+            out[RIGHT_EAR] += tap->gain[RIGHT_EAR]*line[(refl_pos - tap->delay[RIGHT_EAR]) & (REFL_LINE - 1)];
+        }
+        DAC_data_A += (int)out[LEFT_EAR];
+        DAC_data_B += (int)out[RIGHT_EAR];
     }
+    refl_pos = (refl_pos + 1) & (REFL_LINE - 1);
+    // the street, in 1/16 DAC codes to the reverb
+    reverb_sample((int)(send*16), wet);
+    DAC_data_A += wet[LEFT_EAR];
+    DAC_data_B += wet[RIGHT_EAR];
+    // output range for the telemetry
+    if (DAC_data_A < dac_peak.min[LEFT_EAR]) dac_peak.min[LEFT_EAR] = DAC_data_A;
+    if (DAC_data_A > dac_peak.max[LEFT_EAR]) dac_peak.max[LEFT_EAR] = DAC_data_A;
+    if (DAC_data_B < dac_peak.min[RIGHT_EAR]) dac_peak.min[RIGHT_EAR] = DAC_data_B;
+    if (DAC_data_B > dac_peak.max[RIGHT_EAR]) dac_peak.max[RIGHT_EAR] = DAC_data_B;
     
-    if (car_note_time_right < (car_attack_time_right + car_decay_time_right + car_sustain_time_right)){
-        current_car_amplitude_right = (car_note_time_right <= car_attack_time_right)? 
-            current_car_amplitude_right + car_attack_inc_right : 
-            (car_note_time_right <= car_attack_time_right + car_sustain_time_right)? current_car_amplitude_right:
-                current_car_amplitude_right - car_decay_inc_right;
-    } else { 
-        current_car_amplitude_right = threshold_amplitude; // no sound
+    // amplitude tuning: attack, sustain, decay, then silence
+    for (s = 0; s < NUM_SOURCES; s++) {
+        for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++) {
+            e = &env[s][ear];
+            if (e->note_time < sp->src[s].decay_end){
+                e->current = (e->note_time <= sp->src[s].attack_end)? 
+                    e->current + e->attack_inc : 
+                    (e->note_time <= sp->src[s].sustain_end)? e->current:
+                        e->current - e->decay_inc;
+            } else { 
+                e->current = sp->src[s].threshold; // no sound
+            }
+        }
     }
 
     while (TxBufFullSPI2()); // test for ready
-    SPI_Mode16();            // reset spi mode to avoid conflict with expander
     mPORTBClearBits(BIT_4);  // DAC-A CS low to start transaction
     WriteSPI2(DAC_config_chan_A | (DAC_data_A & 0xfff) );  // write to spi2
 
@@ -260,179 +484,895 @@ void __ISR(_TIMER_2_VECTOR, ipl2) Timer2Handler(void)
 
     // while waiting for SPI transaction, check audio counters
     // move to the next sound samplie; if finished one iteration, start replaying
-    if (note_time_left < 100000) note_time_left++;
-    else note_time_left = 0;
-    if (note_time_right < 100000) note_time_right++;
-    else note_time_right = 0;
-    if (car_note_time_left < 2856) car_note_time_left++;
-    else car_note_time_left = 0;
-    if (car_note_time_right < 2856) car_note_time_right++;
-    else car_note_time_right = 0;
-    if (bell_note_time_left < 70000) bell_note_time_left++;
-    else bell_note_time_left = 0;
-    if (bell_note_time_right < 70000) bell_note_time_right++;
-    else bell_note_time_right = 0;
+    for (s = 0; s < NUM_SOURCES; s++) {
+        for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++) {
+            if (env[s][ear].note_time < sp->src[s].note_length) env[s][ear].note_time++;
+            else if (!sp->src[s].moving) start_note(NOTE_ON(s, ear));
+            else if (ear != far_now[s]) restart = 1;
+        }
+        // a moving source's note starts over when the near ear's is
+        // done, with the far ear published now
+        if (restart) {
+            restart = 0;
+            far_now[s] = sp->src[s].far_ear;
+            start_note(NOTE_ON(s, !far_now[s]));
+        }
+        // and its ITD moves a sample a block toward the published one
+        if ((refl_pos & (ITD_BLOCK - 1)) == 0) {
+            if (itd_now[s] < sp->src[s].itd_samples) itd_now[s]++;
+            else if (itd_now[s] > sp->src[s].itd_samples) itd_now[s]--;
+        }
+    }
     
     while (SPI2STATbits.SPIBUSY); // wait for end of transaction
     junk = ReadSPI2();            // MUST read to clear buffer for port expander elsewhere in code
     mPORTBSetBits(BIT_4); // CS high - end transaction
+    
+    // the bus is idle until the next sample: one queued expander transaction
+    spi2_service();
+    // the next sample is already due: this one ran longer than its period
+    ISR_PROF_OVERRUN(&isr_prof[PROF_T2], IFS0bits.T2IF);
+    ISR_PROF_EXIT(&isr_prof[PROF_T2]);
 }
 
 // ISR for bird sound spatial audio delay implementation
 void __ISR(_TIMER_3_VECTOR, ipl1) Timer3Handler(void)
 {
+    ISR_PROF_ENTER();
     mT3ClearIntFlag();
-    timer3_counter++;
-    if (left == 1) {
-        // sound source on the right
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_amplitude_left = (_Accum)((double)(max_amplitude - threshold_amplitude) *amplitude_ratio)+threshold_amplitude;
-        attack_inc_left = (max_amplitude_left-threshold_amplitude)/(_Accum)attack_time_left;
-        decay_inc_left = (max_amplitude_left-threshold_amplitude)/(_Accum)decay_time_left;
-        // set note time to 0 to enable audio
-        note_time_left = 0;
-    } else {
-        // sound source on the left
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_amplitude_right = (_Accum)((double)(max_amplitude - threshold_amplitude) *amplitude_ratio)+threshold_amplitude;
-        attack_inc_right = (max_amplitude_right-threshold_amplitude)/(_Accum)attack_time_right;
-        decay_inc_right = (max_amplitude_right-threshold_amplitude)/(_Accum)decay_time_right;
-        // set note time to 0 to enable audio
-        note_time_right = 0;
-    }
+    // the further channel starts now, on the next sample
+    spsc_put(&far_queue, NOTE_ON(BIRD, DBUF_FRONT(spatial)->src[BIRD].far_ear));
     CloseTimer3();
+    ISR_PROF_EXIT(&isr_prof[PROF_T3]);
 }
 
 // ISR for car sound spatial audio delay implementation
 void __ISR(_TIMER_4_VECTOR, ipl1) Timer4Handler(void)
 {
+    ISR_PROF_ENTER();
     mT4ClearIntFlag();
-    timer4_counter++;
-    if (car_left == 1) {
-        // sound source on the right
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_car_amplitude_left = (_Accum)((double)(max_car_amplitude - threshold_amplitude) *car_amplitude_ratio)+threshold_amplitude;
-        car_attack_inc_left = (max_car_amplitude_left-threshold_amplitude)/(_Accum)car_attack_time_left;
-        car_decay_inc_left = (max_car_amplitude_left-threshold_amplitude)/(_Accum)car_decay_time_left;
-        // set note time to 0 to enable audio
-        car_note_time_left = 0;
-    } else {
-        // sound source on the left
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_car_amplitude_right = (_Accum)((double)(max_car_amplitude - threshold_amplitude) * car_amplitude_ratio)+threshold_amplitude;
-        car_attack_inc_right = (max_car_amplitude_right-threshold_amplitude)/(_Accum)car_attack_time_right;
-        car_decay_inc_right = (max_car_amplitude_right-threshold_amplitude)/(_Accum)car_decay_time_right;
-        // set note time to 0 to enable audio
-        car_note_time_right = 0;
-    }
+    // the further channel starts now, on the next sample
+    spsc_put(&far_queue, NOTE_ON(CAR, DBUF_FRONT(spatial)->src[CAR].far_ear));
     CloseTimer4();
+    ISR_PROF_EXIT(&isr_prof[PROF_T4]);
 }
 
 // ISR for bell sound spatial audio delay implementation
 void __ISR(_TIMER_5_VECTOR, ipl1) Timer5Handler(void)
 {
+    ISR_PROF_ENTER();
     mT5ClearIntFlag();
-    timer5_counter++;
-    if (bell_left == 1) {
-        // sound source on the right
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_bell_amplitude_left = (_Accum)((double)(max_bell_amplitude - bell_threshold_amplitude) * bell_amplitude_ratio)+bell_threshold_amplitude;
-        bell_attack_inc_left = (max_bell_amplitude_left-bell_threshold_amplitude)/(_Accum)bell_attack_time_left;
-        bell_decay_inc_left = (max_bell_amplitude_left-bell_threshold_amplitude)/(_Accum)bell_decay_time_left;
-        // set note time to 0 to enable audio
-        bell_note_time_left = 0;
-    } else {
-        // sound source on the left
-        // perform spatial audio amplitude ratio tuning
-        // calculate the amplitude change per sample during attack and decay
-        max_bell_amplitude_right = (_Accum)((double)(max_bell_amplitude - bell_threshold_amplitude) * bell_amplitude_ratio)+bell_threshold_amplitude;
-        bell_attack_inc_right = (max_bell_amplitude_right-bell_threshold_amplitude)/(_Accum)bell_attack_time_right;
-        bell_decay_inc_right = (max_bell_amplitude_right-bell_threshold_amplitude)/(_Accum)bell_decay_time_right;
-        // set note time to 0 to enable audio
-        bell_note_time_right = 0;
-    }
+    // the further channel starts now, on the next sample
+    spsc_put(&far_queue, NOTE_ON(BELL, DBUF_FRONT(spatial)->src[BELL].far_ear));
     CloseTimer5();
+    ISR_PROF_EXIT(&isr_prof[PROF_T5]);
+}
+
+// expander INT on INT2: a key changed
+void __ISR(_EXTERNAL_2_VECTOR, ipl1) ExtInt2Handler(void)
+{
+    ISR_PROF_ENTER();
+    pe_keys_isr();
+    PT_ISR_WAKE();
+    ISR_PROF_EXIT(&isr_prof[PROF_INT2]);
+}
+
+// === spatial parameter grid ========================================
+// What the listener hears of a source depends only on where it stands,
+// and the joystick moves it scene.step pixels at a time. The atan, cos,
+// sin and log10 of every grid point are done once, when a scene is
+// loaded or a source is tuned; spatial_update interpolates between the
+// four grid points around the listener, which tuning may put between
+// them.
+struct spatial_cell {
+    unsigned short peak;            // near ear peak amplitude, 1/32 steps
+    unsigned short ratio;           // far/near amplitude ratio, Q15
+    short itd;                      // far ear delay in 1/256 samples,
+                                    // > 0 when the left ear is the far one
+    unsigned char air;              // air absorption bin, by distance
+    unsigned char occ;              // occluded cells, see occlusion_step;
+                                    // OCC_UNKNOWN until its ray is cast
+};
+#define CELL_PEAK_ONE 32
+#define CELL_RATIO_ONE 32767
+#define CELL_ITD_ONE 256
+#define OCC_UNKNOWN 0xff
+// 8 bytes a point; a scene whose walkable area needs more points per
+// source is computed directly at each update instead
+#define GRID_POINTS_MAX 256
+static struct spatial_cell grid[NUM_SOURCES][GRID_POINTS_MAX];
+// grid points across and down, 0 when the scene's grid does not fit
+static int grid_nx, grid_ny;
+
+// the spatial model for one source and a listener at x, y
+static void spatial_cell_compute(const struct scene_source *src, int x, int y,
+        struct spatial_cell *c)
+{
+    int x_diff = src->x - x, y_diff = src->y - y, itd;
+    double angle_rad, delay, distance, peak;
+    // amplitude ratio & delay, the delay used in timer 3/4/5 interrupt
+    // for the further channel; on the source itself straight ahead
+    angle_rad = (x_diff == 0 && y_diff == 0)? 0 : atan2(abs(x_diff), abs(y_diff));
+    delay = head_radius*(angle_rad + sin(angle_rad))/sound_speed;
+    // intensity decay: each source has its own curve in the scene;
+    // closer than a pixel is as loud as a pixel away
+    distance = sqrt((x_diff*x_diff)+(y_diff*y_diff));
+    if (distance < 1) distance = 1;
+    peak = src->max - (src->atten_k*log10(distance/src->atten_d0) + src->atten_c);
+    if (peak < 0) peak = 0;
+    else if (peak > src->clamp) peak = src->clamp;
+    c->peak = (unsigned short)(peak*CELL_PEAK_ONE + 0.5);
+    c->air = (distance < AIR_BINS*AIR_BIN_PX)? (int)distance/AIR_BIN_PX : AIR_BINS - 1;
+    c->occ = OCC_UNKNOWN;
+    c->ratio = (unsigned short)(cos(angle_rad)*CELL_RATIO_ONE + 0.5);
+    itd = (int)(delay*(pb_clock)/(SAMPLE_PERIOD + 1)*CELL_ITD_ONE + 0.5);
+    // sound source on the right: the left ear is the further one, even
+    // when the delay rounds to nothing
+    c->itd = (x_diff > 0)? ((itd > 0)? itd : 1) : -itd;
+}
+
+// grid points of source s -- timer thread only
+static void spatial_grid_build(int s)
+{
+    int i, j;
+    for (j = 0; j < grid_ny; j++)
+        for (i = 0; i < grid_nx; i++)
+            spatial_cell_compute(&scene.src[s], scene.min_x + i*scene.step,
+                scene.min_y + j*scene.step, &grid[s][j*grid_nx + i]);
+}
+
+// a grid over the walkable area of a new scene, if it fits
+static void spatial_grid_init(void)
+{
+    int s;
+    // no scene at all
+    grid_nx = grid_ny = 0;
+    if (scene.step == 0) return;
+    grid_nx = (scene.max_x - scene.min_x + scene.step - 1)/scene.step + 1;
+    grid_ny = (scene.max_y - scene.min_y + scene.step - 1)/scene.step + 1;
+    if (grid_nx*grid_ny > GRID_POINTS_MAX) grid_nx = grid_ny = 0;
+    for (s = 0; s < scene.sources; s++) spatial_grid_build(s);
+}
+
+// source s heard at x, y: bilinear between the grid points around it,
+// exactly a grid point on one. Where the source crosses the listener's
+// axis the points lead with different ears, and their ITDs would blend
+// into none at all: there it is the nearest point.
+static void spatial_grid_lookup(int s, int x, int y, struct spatial_cell *c)
+{
+    const struct spatial_cell *c00, *c10, *c01, *c11;
+    int i = (x - scene.min_x)/scene.step, j = (y - scene.min_y)/scene.step;
+    int i1 = (i + 1 < grid_nx)? i + 1 : i, j1 = (j + 1 < grid_ny)? j + 1 : j;
+    float fx = (float)(x - scene.min_x - i*scene.step)/scene.step;
+    float fy = (float)(y - scene.min_y - j*scene.step)/scene.step;
+    c00 = &grid[s][j*grid_nx + i];
+    c10 = &grid[s][j*grid_nx + i1];
+    c01 = &grid[s][j1*grid_nx + i];
+    c11 = &grid[s][j1*grid_nx + i1];
+    if ((c00->itd > 0) != (c10->itd > 0) || (c00->itd > 0) != (c01->itd > 0) ||
+            (c00->itd > 0) != (c11->itd > 0)) {
+        *c = grid[s][((fy < 0.5f)? j : j1)*grid_nx + ((fx < 0.5f)? i : i1)];
+        return;
+    }
+#define GRID_LERP(f) ((1-fy)*((1-fx)*c00->f + fx*c10->f) + fy*((1-fx)*c01->f + fx*c11->f))
+    c->peak = (unsigned short)(GRID_LERP(peak) + 0.5f);
+    c->ratio = (unsigned short)(GRID_LERP(ratio) + 0.5f);
+    c->itd = (short)floorf(GRID_LERP(itd) + 0.5f);
+    c->air = (unsigned char)(GRID_LERP(air) + 0.5f);
+#undef GRID_LERP
+}
+
+// === occlusion =====================================================
+// The buildings of a scene, its PRIM_OCCLUDE shapes, stand between the
+// listener and a source when the straight line from one to the other
+// crosses them; scene_ray counts the occluded map cells on the way.
+// Each cell takes 3 dB off the source, and lowers the cutoff of its air
+// absorption filter to 4000 Hz/cells if that is lower than the air's.
+// The counts are kept with the spatial grid, per source and listener
+// grid point. The timer thread casts at most one ray a pass, round the
+// sources; a source whose ray is not cast yet keeps its count from
+// before.
+#define OCC_DEPTHS 8
+static const unsigned short occ_gain_q15[OCC_DEPTHS] = {
+    32768, 23198, 16423, 11627, 8231, 5827, 4125, 2920
+};
+static const unsigned short occ_k_q15[OCC_DEPTHS] = {
+    32768, 21275, 13362, 9659, 7551, 6195, 5250, 4555
+};
+// occluded cells between the listener and each source, as
+// spatial_update uses them
+static unsigned char occ_depth[NUM_SOURCES];
+// the source whose ray is looked at first next pass
+static int occ_next;
+// host_sim -g turns it off, the notebook model has no buildings
+int occlusion_on = 1;
+
+// a new scene: nothing in the way until the rays are cast
+static void occlusion_reset(void)
+{
+    memset(occ_depth, 0, sizeof(occ_depth));
+    occ_next = 0;
+}
+
+// the cached counts at the listener's grid point, and one ray for a
+// source that has none there; returns a bit for each source whose count
+// changed -- timer thread only
+static int occlusion_step(void)
+{
+    int x = Accum2int(xpos), y = Accum2int(ypos), point = -1, i, j, n, s, d;
+    int cast = 0, changed = 0;
+    // the nearest grid point, whose ray stands for the cell around it
+    if (grid_nx) {
+        i = (x - scene.min_x + scene.step/2)/scene.step;
+        j = (y - scene.min_y + scene.step/2)/scene.step;
+        if (i >= grid_nx) i = grid_nx - 1;
+        if (j >= grid_ny) j = grid_ny - 1;
+        point = j*grid_nx + i;
+        x = scene.min_x + i*scene.step;
+        y = scene.min_y + j*scene.step;
+    }
+    for (n = 0; n < scene.sources; n++) {
+        s = (occ_next + n) % scene.sources;
+        // the motion thread casts the rays of moving sources
+        if (scene.src[s].speed > 0) continue;
+        if (point >= 0 && grid[s][point].occ != OCC_UNKNOWN) {
+            d = grid[s][point].occ;
+        } else {
+            if (cast) continue;
+            d = scene_ray(&scene, x, y, scene.src[s].x, scene.src[s].y);
+            if (d >= OCC_DEPTHS) d = OCC_DEPTHS - 1;
+            if (point >= 0) grid[s][point].occ = d;
+            occ_next = s + 1;
+            cast = 1;
+        }
+        if (d != occ_depth[s]) changed |= 1 << s;
+        occ_depth[s] = d;
+    }
+    return changed;
+}
+
+// === spatial audio parameters ======================================
+// a noise voice of the scene for the ISR, shifted by doppler: the cutoffs
+// and dampings as SVF coefficients, and the input level that makes the
+// output about 0.2 RMS in the middle of the sweep -- filtered white
+// noise has an RMS of about 0.715*sqrt(f/damp) of its input
+static void noise_voice_params(struct noise_voice *n, const struct scene_voice *v, double doppler)
+{
+    double fs = (double)(pb_clock)/(SAMPLE_PERIOD + 1);
+    double lo = 2*sin(3.14159265*v->u.noise.f_lo*doppler/fs);
+    double hi = 2*sin(3.14159265*v->u.noise.f_hi*doppler/fs);
+    double damp = 1/v->u.noise.q, damp_hi = 1/v->u.noise.q_hi;
+    double level = 0.2/(0.715*sqrt((lo + hi)/(damp + damp_hi)));
+    n->f_lo = (int)(lo*32768 + 0.5);
+    n->period = v->u.noise.period;
+    n->slope = (int)((hi - lo)*32768*65536/(n->period/2));
+    n->damp = (int)(damp*32768 + 0.5);
+    n->damp_slope = (int)((damp_hi - damp)*32768*256/(n->period/2));
+    n->level = (level < 1)? (int)(level*32768) : 32767;
+    n->band = v->u.noise.band;
+}
+
+// an FM voice of the scene for the ISR, frequencies as DDS increments
+// at the real sample rate, shifted by doppler
+static void fm_voice_params(struct fm_voice *f, const struct scene_voice *v, double doppler)
+{
+    f->carrier_inc = (unsigned int)(v->u.fm.f*doppler*DDS_HZ + 0.5);
+    f->mod_inc = (unsigned int)(v->u.fm.f*v->u.fm.ratio*doppler*DDS_HZ + 0.5);
+    f->index = (_Accum)(v->u.fm.index0*FM_INDEX_ONE);
+    f->index_step = (_Accum)((v->u.fm.index1 - v->u.fm.index0)*FM_INDEX_ONE/v->u.fm.decay);
+    f->index_end = v->u.fm.decay;
+}
+
+// envelope slopes of both ears for one source: the near ear rises to
+// peak, the far ear to peak scaled by the amplitude ratio cos(angle)
+static void source_spatial_params(struct source_params *p, const struct scene_source *src,
+        int far_ear, _Accum peak, _Accum threshold, double ratio)
+{
+    _Accum far_peak = (_Accum)((double)(peak - threshold) * ratio) + threshold;
+    p->far_ear = far_ear;
+    p->threshold = threshold;
+    p->attack_inc[!p->far_ear] = (peak-threshold)/(_Accum)src->attack;
+    p->decay_inc[!p->far_ear] = (peak-threshold)/(_Accum)src->decay;
+    p->attack_inc[p->far_ear] = (far_peak-threshold)/(_Accum)src->attack;
+    p->decay_inc[p->far_ear] = (far_peak-threshold)/(_Accum)src->decay;
+    p->attack_end = src->attack;
+    p->sustain_end = src->attack + src->sustain;
+    p->decay_end = src->attack + src->sustain + src->decay;
+    p->note_length = src->length;
+    p->voice = src->voice;
+}
+
+// the reflection taps of a source heard at x, y with near ear peak
+// peak; none while it cannot be heard
+static void source_reflections(struct source_params *p, const struct scene_source *src,
+        int x, int y, _Accum peak)
+{
+    struct scene_point img[REFL_TAPS];
+    struct scene_source image = *src;
+    struct spatial_cell c;
+    struct reflection_tap *tap;
+    double direct, gain;
+    int n, i, delay, itd, far;
+    p->taps = 0;
+    p->refl_scale = 0;
+    if (!reflections_on || peak <= 0) return;
+    p->refl_scale = (_Accum)(REFL_ONE/(float)peak);
+    n = scene_reflections(&scene, x, y, src->x, src->y, img, REFL_TAPS);
+    direct = sqrt((double)(src->x - x)*(src->x - x) + (double)(src->y - y)*(src->y - y));
+    for (i = 0; i < n; i++) {
+        // the path off the wall is as long as the one from the image
+        image.x = img[i].x;
+        image.y = img[i].y;
+        spatial_cell_compute(&image, x, y, &c);
+        delay = (int)((sqrt((double)(image.x - x)*(image.x - x) + (double)(image.y - y)*(image.y - y))
+            - direct)*MAP_CM_PER_PX/sound_speed*(pb_clock)/(SAMPLE_PERIOD + 1) + 0.5);
+        itd = (abs(c.itd) + CELL_ITD_ONE/2)/CELL_ITD_ONE;
+        // nearest first, so the rest are too late as well
+        if (delay + itd >= REFL_LINE) break;
+        far = (c.itd > 0)? LEFT_EAR : RIGHT_EAR;
+        gain = (double)c.peak/CELL_PEAK_ONE*REFL_WALL/REFL_ONE;
+        tap = &p->tap[p->taps++];
+        tap->delay[!far] = delay;
+        tap->delay[far] = delay + itd;
+        tap->gain[!far] = (_Accum)gain;
+        tap->gain[far] = (_Accum)(gain*c.ratio/CELL_RATIO_ONE);
+    }
+}
+
+// pitch factor of a source on its path heard at x, y: 1 when it stays
+static double source_doppler(const struct scene_source *src, int x, int y)
+{
+    double dx = src->to_x - src->from_x, dy = src->to_y - src->from_y;
+    double rx = src->x - x, ry = src->y - y;
+    double len = sqrt(dx*dx + dy*dy), d = sqrt(rx*rx + ry*ry), away;
+    if (src->speed <= 0 || len < 1 || d < 1) return 1;
+    // its speed away from the listener, cm/s
+    away = src->speed*MAP_CM_PER_PX*(dx*rx + dy*ry)/(len*d);
+    return sound_speed/(sound_speed + away);
+}
+
+// everything about source s for a listener at x, y, into p
+static void source_update(struct source_params *p, int s, int x, int y)
+{
+    struct scene_source *src = &scene.src[s];
+    struct spatial_cell c;
+    int bin, occ, k;
+    double distance, doppler;
+    // from the grid around the "human", or worked out if there is none
+    // or the source moves
+    if (grid_nx && src->speed == 0) spatial_grid_lookup(s, x, y, &c);
+    else spatial_cell_compute(src, x, y, &c);
+    source_ratio[s] = (double)c.ratio/CELL_RATIO_ONE;
+    source_itd[s] = abs(c.itd)*(SAMPLE_PERIOD + 1)/CELL_ITD_ONE;
+    occ = occlusion_on ? occ_depth[s] : 0;
+    source_peak[s] = (_Accum)((float)c.peak/CELL_PEAK_ONE*occ_gain_q15[occ]/32768);
+    // perform spatial audio amplitude ratio tuning
+    source_spatial_params(p, src, (c.itd > 0)? LEFT_EAR : RIGHT_EAR,
+        source_peak[s], (_Accum)src->threshold, source_ratio[s]);
+    // head shadow of the far ear, by azimuth bin
+    bin = (int)(acos(source_ratio[s])/HS_BIN_RAD + 0.5);
+    if (bin >= HS_BINS) bin = HS_BINS - 1;
+    p->shadow = head_shadow_on ? (_Accum)((float)head_shadow_q15[bin]/32768) : HS_OPEN;
+    // air absorption of both ears, by distance bin, or the buildings
+    // in the way if they take more
+    k = air_absorption_on ? air_q15[c.air] : 32768;
+    if (occ_k_q15[occ] < k) k = occ_k_q15[occ];
+    p->air = (k == 32768)? AIR_OPEN : (_Accum)((float)k/32768);
+    // walls the source is heard off as well
+    source_reflections(p, src, x, y, source_peak[s]);
+    // and the street around the listener, more of it from far away
+    distance = sqrt((double)(src->x - x)*(src->x - x) + (double)(src->y - y)*(src->y - y));
+    p->reverb_send = reverb_on ? (_Accum)(REVERB_SEND*distance/(distance + REVERB_NEAR_PX)) : 0;
+    // pitch, raised coming closer and lowered going away
+    doppler = source_doppler(src, x, y);
+    p->dds_constant = DDS_constant*doppler;
+    p->contour_inc = (unsigned int)(DDS_HZ*doppler + 0.5);
+    if (src->voice.type == VOICE_NOISE) noise_voice_params(&p->noise, &src->voice, doppler);
+    if (src->voice.type == VOICE_FM) fm_voice_params(&p->fm, &src->voice, doppler);
+    p->moving = src->speed > 0;
+    p->itd_samples = (abs(c.itd) + CELL_ITD_ONE/2)/CELL_ITD_ONE;
+    if (p->itd_samples >= ITD_LINE) p->itd_samples = ITD_LINE - 1;
+    p->ild = (_Accum)source_ratio[s];
+}
+
+// === spatial audio update ==========================================
+// where the listener was for the last spatial_update
+static int spatial_x = -1, spatial_y = -1;
+
+// recompute the parameters of every source for the current listener
+// position, publish them and restart the notes: near ears now, far
+// ears from Timer3/4/5 after the interaural delay
+static void spatial_update(void)
+{
+    // the new parameter set is built in the back copy
+    struct spatial_params *sp = DBUF_EDIT(spatial);
+    int s, x = Accum2int(xpos), y = Accum2int(ypos);
+    
+    spatial_x = x;
+    spatial_y = y;
+    for (s = 0; s < NUM_SOURCES; s++) {
+        // slots the scene leaves empty stay silent
+        if (s >= scene.sources) {
+            memset(&sp->src[s], 0, sizeof(sp->src[s]));
+            sp->src[s].shadow = HS_OPEN;
+            sp->src[s].air = AIR_OPEN;
+            source_ratio[s] = 0;
+            source_peak[s] = 0;
+            source_itd[s] = 1;
+            continue;
+        }
+        source_update(&sp->src[s], s, x, y);
+    }
+    
+    // hand the whole set to the ISRs at once, then start the near
+    // ears; the further channels are started after the delay
+    DBUF_PUBLISH(spatial);
+    for (s = 0; s < NUM_SOURCES; s++) spsc_put(&near_queue, NOTE_ON(s, !sp->src[s].far_ear));
+    
+    // timer interrupt
+    // Set up timer2 on for DAC
+    // timer value = pb_clock/sample rate
+    OpenTimer2(T2_ON | T2_SOURCE_INT | T2_PS_1_1, SAMPLE_PERIOD);
+    // set up the timer interrupt with a priority of 2
+    ConfigIntTimer2(T2_INT_ON | T2_INT_PRIOR_2);
+    mT2ClearIntFlag(); // and clear the interrupt flag
+    // Timer 3 Setup -- bird audio delay tuning
+    OpenTimer3(T3_ON | T3_SOURCE_INT | T3_PS_1_1, source_itd[BIRD]);
+    // set up the timer interrupt with a priority of 1
+    ConfigIntTimer3(T3_INT_ON | T3_INT_PRIOR_1);
+    mT3ClearIntFlag(); // and clear the interrupt flag
+    // Timer 4 Setup -- car audio delay tuning
+    OpenTimer4(T4_ON | T4_SOURCE_INT | T4_PS_1_1, source_itd[CAR]);
+    // set up the timer interrupt with a priority of 1
+    ConfigIntTimer4(T4_INT_ON | T4_INT_PRIOR_1);
+    mT4ClearIntFlag(); // and clear the interrupt flag
+    // Timer 5 Setup -- bell audio delay tuning
+    OpenTimer5(T5_ON | T5_SOURCE_INT | T5_PS_1_1, source_itd[BELL]);
+    // set up the timer interrupt with a priority of 1
+    ConfigIntTimer5(T5_INT_ON | T5_INT_PRIOR_1);
+    mT5ClearIntFlag(); // and clear the interrupt flag
+}
+
+// recompute the parameters of the sources in the mask for a listener
+// at x, y and publish them, without restarting their notes: the ISR
+// takes their slopes and far ear at the next loop of each note -- timer
+// and motion threads
+static void sources_publish(int sources, int x, int y)
+{
+    struct spatial_params *sp;
+    int s;
+    if (!sources) return;
+    sp = DBUF_EDIT(spatial);
+    for (s = 0; s < scene.sources; s++)
+        if (sources & (1 << s)) source_update(&sp->src[s], s, x, y);
+    DBUF_PUBLISH(spatial);
+}
+
+// the rays cast or looked up this pass: sources whose occlusion changed
+// at the position the listener was last heard from are published again,
+// as they would have been had every ray been cast with the press; away
+// from it the counts wait in occ_depth for the next spatial_update --
+// timer thread only
+static void occlusion_publish(void)
+{
+    int changed = occlusion_step();
+    if (Accum2int(xpos) == spatial_x && Accum2int(ypos) == spatial_y)
+        sources_publish(changed, spatial_x, spatial_y);
+}
+
+// === source motion =================================================
+// A source with a path in the scene moves along it at its speed and
+// starts over at the end. Every MOTION_MSEC the motion thread moves it
+// as far as it went in the time since the last move, however late the
+// scheduler ran the thread, and works its parameters out again, without
+// restarting its notes: its Doppler factor goes into the DDS constant
+// and the noise and FM coefficients at once, its ITD and ILD glide
+// there in the ISR (see itd_line), its slopes and far ear change at
+// the next loop of its note. The ISR synthesizes one ear for it where
+// a source that stays takes two.
+#define MOTION_MSEC 50
+// pixels along its path each source is, and when they were moved there
+static float motion_dist[NUM_SOURCES];
+static unsigned int motion_time;
+
+// a new scene: the sources at the start of their paths, from now
+static void motion_reset(void)
+{
+    memset(motion_dist, 0, sizeof(motion_dist));
+    motion_time = PT_GET_TIME();
+}
+
+// move the sources on paths and publish what they sound like now --
+// motion thread only
+static void motion_step(void)
+{
+    struct scene_source *src;
+    int s, d, x = Accum2int(xpos), y = Accum2int(ypos), moved = 0;
+    unsigned int now = PT_GET_TIME(), msec = now - motion_time;
+    float dx, dy, len;
+    motion_time = now;
+    for (s = 0; s < scene.sources; s++) {
+        src = &scene.src[s];
+        if (src->speed <= 0) continue;
+        dx = src->to_x - src->from_x;
+        dy = src->to_y - src->from_y;
+        len = sqrtf(dx*dx + dy*dy);
+        if (len < 1) continue;
+        motion_dist[s] += src->speed*msec/1000;
+        while (motion_dist[s] >= len) motion_dist[s] -= len;
+        src->x = src->from_x + (int)floorf(dx*motion_dist[s]/len + 0.5f);
+        src->y = src->from_y + (int)floorf(dy*motion_dist[s]/len + 0.5f);
+        // no cached rays for it
+        d = scene_ray(&scene, x, y, src->x, src->y);
+        occ_depth[s] = (d < OCC_DEPTHS)? d : OCC_DEPTHS - 1;
+        moved |= 1 << s;
+    }
+    sources_publish(moved, x, y);
 }
 
-// === TFT map  ======================================================
-void collegetown_map(void) {
-    tft_fillRect(80, 0, 80, 320, ILI9340_BLACK);
-    tft_fillRect(0, 120, 240, 80, ILI9340_BLACK);
-    int ix, iy;
-    // cross walk
-    for (ix = 82; ix < 160; ix = ix + 10) {
-        tft_fillRect(ix, 100, 5, 20, ILI9340_WHITE);
-        tft_fillRect(ix, 200, 5, 20, ILI9340_WHITE);
+// === live tuning ===================================================
+// FRAME_COMMAND frames (see serial_frame.h) set source parameters and
+// the listener position at run time. The payload is a list of records
+//   u8 param, u8 source, s32 value
+// amplitudes in 16.16 fixed point, positions in pixels, times in samples;
+// the source is ignored for the listener. A frame is checked as a whole
+// and queued, and the timer thread applies everything queued in one pass
+// and republishes the spatial parameters: the audio ISRs go from the old
+// set to the new one between two samples, within one control period of
+// the frame. FRAME_SCENE frames upload a whole new scene, see below.
+// Each frame is answered with a FRAME_ACK: u8 seq, u8 status, u8 record
+// (the first record that was refused, or the scene_load result).
+enum { TUNE_LISTENER_X, TUNE_LISTENER_Y, TUNE_SOURCE_X, TUNE_SOURCE_Y,
+       TUNE_MAX_AMPLITUDE, TUNE_THRESHOLD, TUNE_ATTACK, TUNE_DECAY,
+       TUNE_SUSTAIN, TUNE_NOTE_LENGTH, TUNE_PARAMS };
+enum { TUNE_OK, TUNE_BAD_LENGTH, TUNE_BAD_PARAM, TUNE_BAD_SOURCE,
+       TUNE_BAD_VALUE, TUNE_BUSY, TUNE_BAD_TYPE, TUNE_BAD_SCENE };
+#define TUNE_RECORD 6
+// records waiting for the timer thread
+#define TUNE_QUEUE 32
+struct tune_cmd { unsigned char param, source; int value; };
+static struct tune_cmd tune_queue[TUNE_QUEUE];
+static int tune_count;
+
+// the amplitude range of one DAC side, in 16.16
+#define TUNE_AMPLITUDE_MAX (2047 << 16)
+#define TUNE_TIME_MAX 1000000
+
+// 1 if a listener at x, y would stand on a source
+static int listener_on_source(int x, int y)
+{
+    int s;
+    for (s = 0; s < scene.sources; s++)
+        if (scene.src[s].x == x && scene.src[s].y == y) return 1;
+    return 0;
+}
+
+// where the listener and the sources would stand, for checking a frame
+struct tune_place { int x, y, src_x[NUM_SOURCES], src_y[NUM_SOURCES]; };
+
+// move the listener or a source of a place as a record would; returns 1
+// if the record was one that moves something
+static int tune_move(struct tune_place *p, const struct tune_cmd *c)
+{
+    switch (c->param) {
+    case TUNE_LISTENER_X: p->x = c->value; return 1;
+    case TUNE_LISTENER_Y: p->y = c->value; return 1;
+    case TUNE_SOURCE_X: p->src_x[c->source] = c->value; return 1;
+    case TUNE_SOURCE_Y: p->src_y[c->source] = c->value; return 1;
     }
-    for (iy = 122; iy < 200; iy = iy + 10) {
-        tft_fillRect(60, iy, 20, 5, ILI9340_WHITE);
-        tft_fillRect(160, iy, 20, 5, ILI9340_WHITE);
+    return 0;
+}
+
+// refuse what would break the spatial math: the listener where the
+// joystick cannot go, or a listener and a source in the same place
+static int tune_place_check(const struct tune_place *p)
+{
+    int s;
+    if (!scene_walkable(&scene, p->x, p->y)) return TUNE_BAD_VALUE;
+    for (s = 0; s < scene.sources; s++)
+        if (p->src_x[s] == p->x && p->src_y[s] == p->y) return TUNE_BAD_VALUE;
+    return TUNE_OK;
+}
+
+// refuse a record that is out of range on its own; where things end up
+// is checked for the frame as a whole
+static int tune_check(struct tune_cmd *c)
+{
+    int v = c->value;
+    if (c->param >= TUNE_PARAMS) return TUNE_BAD_PARAM;
+    if (c->param >= TUNE_SOURCE_X && c->source >= scene.sources) return TUNE_BAD_SOURCE;
+    switch (c->param) {
+    case TUNE_LISTENER_X:
+    case TUNE_LISTENER_Y:
+        break;
+    case TUNE_SOURCE_X:
+        if (v < 0 || v >= ILI9340_TFTWIDTH) return TUNE_BAD_VALUE;
+        break;
+    case TUNE_SOURCE_Y:
+        if (v < 0 || v >= ILI9340_TFTHEIGHT) return TUNE_BAD_VALUE;
+        break;
+    case TUNE_MAX_AMPLITUDE:
+    case TUNE_THRESHOLD:
+        if (v < 0 || v > TUNE_AMPLITUDE_MAX) return TUNE_BAD_VALUE;
+        break;
+    case TUNE_SUSTAIN:
+        if (v < 0 || v > TUNE_TIME_MAX) return TUNE_BAD_VALUE;
+        break;
+    default:
+        // attack and decay divide, a note needs at least one sample
+        if (v < 1 || v > TUNE_TIME_MAX) return TUNE_BAD_VALUE;
+        break;
     }
-    // traffic light
-    tft_fillCircle(120, 112, 8, ILI9340_GREEN);
-    tft_fillCircle(168, 160, 8, ILI9340_RED);
-    // construction site
-    tft_fillTriangle(40, 140, 40, 180, 75, 160, ILI9340_ORANGE);
-    tft_fillRect(43, 158, 4, 4, ILI9340_BLACK);
-    tft_fillRect(50, 158, 18, 4, ILI9340_BLACK);
-    // oishii bowl
-    tft_fillRect(165, 216, 5, 14, ILI9340_OISHII);
-    tft_fillCircle(183, 222, 15, ILI9340_OISHII);
-    tft_fillRect(183, 200, 16, 250, ILI9340_GRAY);
-    tft_fillCircle(183, 222, 8, ILI9340_WHITE);
-    tft_fillRect(179, 214, 4, 18, ILI9340_OISHII);
-    tft_fillRect(175, 216, 4, 14, ILI9340_OISHII);
-    // car
-    tft_fillCircle(130, 25, 20, ILI9340_RED);
-    tft_fillRect(110, 5, 20, 50, ILI9340_BLACK);
-    tft_fillRect(144, 5, 10, 50, ILI9340_BLACK);
-    tft_fillCircle(142, 25, 12, ILI9340_GRAY);
-    tft_fillRect(130, 10, 14, 30, ILI9340_RED);
-    tft_fillCircle(130, 15, 3, ILI9340_GRAY);
-    tft_fillCircle(130, 35, 3, ILI9340_GRAY);
-    // middle line
-    for (iy = 0; iy < 100; iy = iy + 10) {
-        tft_fillRect(119, iy, 2, 5, ILI9340_WHITE);
+    return TUNE_OK;
+}
+
+// check every record of a command payload, and where the listener and
+// the sources end up after the records already queued and all of these,
+// then queue them all or none; *bad is the record that was refused, or
+// the last one that moved something if the place they end up in is
+static int tune_accept(const unsigned char *payload, int len, int *bad)
+{
+    static struct tune_cmd c[TUNE_QUEUE];
+    struct tune_place p;
+    int n = len/TUNE_RECORD, i, s, status;
+    *bad = 0;
+    if (len % TUNE_RECORD != 0 || n == 0) return TUNE_BAD_LENGTH;
+    if (tune_count + n > TUNE_QUEUE) return TUNE_BUSY;
+    p.x = Accum2int(xpos);
+    p.y = Accum2int(ypos);
+    for (s = 0; s < scene.sources; s++) {
+        p.src_x[s] = scene.src[s].x;
+        p.src_y[s] = scene.src[s].y;
     }
-    for (iy = 225; iy < 320; iy = iy + 10) {
-        tft_fillRect(119, iy, 2, 5, ILI9340_WHITE);
+    for (i = 0; i < tune_count; i++) tune_move(&p, &tune_queue[i]);
+    for (i = 0; i < n; i++, payload += TUNE_RECORD) {
+        c[i].param = payload[0];
+        c[i].source = payload[1];
+        c[i].value = (int)frame_get32(payload+2);
+        status = tune_check(&c[i]);
+        if (status != TUNE_OK) {
+            *bad = i;
+            return status;
+        }
+        if (tune_move(&p, &c[i])) *bad = i;
     }
-    for (ix = 0; ix < 60; ix = ix + 10) {
-        tft_fillRect(ix, 159, 5, 2, ILI9340_WHITE);
+    status = tune_place_check(&p);
+    if (status != TUNE_OK) return status;
+    *bad = 0;
+    memcpy(&tune_queue[tune_count], c, n*sizeof(c[0]));
+    tune_count += n;
+    return TUNE_OK;
+}
+
+// apply everything queued -- timer thread only, before spatial_update;
+// returns 1 if the listener moved
+static int tune_apply(void)
+{
+    struct tune_cmd *c;
+    struct scene_source *src;
+    int moved = 0, regrid = 0, s;
+    for (c = tune_queue; c < tune_queue + tune_count; c++) {
+        src = &scene.src[c->source];
+        switch (c->param) {
+        case TUNE_LISTENER_X: xpos = int2Accum(c->value); moved = 1; break;
+        case TUNE_LISTENER_Y: ypos = int2Accum(c->value); moved = 1; break;
+        // the start of its path, for a source that moves
+        case TUNE_SOURCE_X: src->x = src->from_x = c->value; regrid |= 1 << c->source; break;
+        case TUNE_SOURCE_Y: src->y = src->from_y = c->value; regrid |= 1 << c->source; break;
+        case TUNE_MAX_AMPLITUDE:
+            src->max = (float)c->value/65536;
+            regrid |= 1 << c->source;
+            break;
+        case TUNE_THRESHOLD: src->threshold = (float)c->value/65536; break;
+        case TUNE_ATTACK: src->attack = c->value; break;
+        case TUNE_DECAY: src->decay = c->value; break;
+        case TUNE_SUSTAIN: src->sustain = c->value; break;
+        case TUNE_NOTE_LENGTH: src->length = c->value; break;
+        }
     }
-    for (ix = 185; ix < 240; ix = ix + 10) {
-        tft_fillRect(ix, 159, 5, 2, ILI9340_WHITE);
+    tune_count = 0;
+    // the grid points of the sources that moved or got louder
+    for (s = 0; s < scene.sources; s++)
+        if (regrid & (1 << s)) spatial_grid_build(s);
+    return moved;
+}
+
+// === scene upload ==================================================
+// FRAME_SCENE payload: u16 offset, then blob bytes from there on. The
+// chunks come in order from offset 0, which starts a new upload; a chunk
+// sent again is harmless. Once the blob is complete it is unpacked into
+// scene_next, and if good the timer thread switches to it in one pass,
+// moving the listener to its start. A blob that comes before the timer
+// thread switched replaces the one waiting, good or bad.
+static unsigned char scene_rx[SCENE_BLOB_MAX];
+static int scene_rx_len;
+static struct scene scene_next;
+static int scene_ready;
+
+static int scene_receive(const unsigned char *payload, int len, int *result)
+{
+    int offset, total;
+    *result = SCENE_OK;
+    if (len < 2) return TUNE_BAD_LENGTH;
+    offset = frame_get16(payload);
+    payload += 2;
+    len -= 2;
+    if (offset == 0) scene_rx_len = 0;
+    if (offset > scene_rx_len || offset + len > SCENE_BLOB_MAX) return TUNE_BAD_VALUE;
+    memcpy(scene_rx + offset, payload, len);
+    if (offset + len > scene_rx_len) scene_rx_len = offset + len;
+    if (scene_rx_len < SCENE_HEADER) return TUNE_OK;
+    // the header says how long the blob is
+    total = frame_get16(scene_rx + 8);
+    if (scene_rx_len < total) return TUNE_OK;
+    scene_ready = 0;
+    *result = scene_load(&scene_next, scene_rx, scene_rx_len);
+    if (*result != SCENE_OK) return TUNE_BAD_SCENE;
+    scene_ready = 1;
+    return TUNE_OK;
+}
+
+// === input record / replay ========================================
+// The inputs the timer thread acts on -- both joystick ADCs, the
+// joystick button and expander key Y0 -- can be recorded into RAM and
+// played back in their place, on the board or in host_sim, so that
+// benchmarks and golden runs walk the same way every time. Only the
+// passes whose inputs mean something new are kept: an axis moving into
+// or out of the joystick dead band, or a button going down or up.
+// Serial commands: 'i r' records from the listener position, 'i s'
+// stops, 'i p' plays the trace back from its start, 'i d' dumps it.
+// FRAME_INPUT payload, both ways, little endian:
+//   u16 start x, y            listener when the trace started
+//   u16 end                   timer passes the trace lasts
+//   u8  first, total          events: the first one in this frame, all
+//   per event, up to INPUT_FRAME_EVENTS:
+//     u16 pass                timer passes since the start
+//     u16 adc x, adc y
+//     u8  buttons             INPUT_BUTTON, INPUT_KEY
+// host/inputs.py saves dumped traces and uploads them.
+#define INPUT_BUTTON 0x01       // joystick button down
+#define INPUT_KEY 0x02          // key Y0 pressed in this pass
+struct input_event {
+    unsigned short pass;
+    unsigned short adc_x, adc_y;
+    unsigned char buttons;
+};
+#define INPUT_EVENTS 128
+#define INPUT_HEADER 8
+#define INPUT_EVENT 7
+// so an upload fits in what the serial thread receives
+#define INPUT_FRAME_EVENTS 7
+enum { INPUT_LIVE, INPUT_RECORD, INPUT_REPLAY };
+static struct input_event input_trace[INPUT_EVENTS];
+static int input_len;                   // events in the trace
+static int input_start_x, input_start_y;
+static unsigned int input_end;          // passes the trace lasts
+static int input_mode;
+static unsigned int input_pass;         // since recording or replay started
+static int input_next;                  // event to replay next
+// events of an upload so far
+static int input_rx_len;
+
+// joystick axis: -1, 0 in the dead band, 1
+static int joystick_axis(int adc)
+{
+    return (adc < 300)? -1 : (adc > 600)? 1 : 0;
+}
+
+static int input_differs(const struct input_event *a, const struct input_event *b)
+{
+    return joystick_axis(a->adc_x) != joystick_axis(b->adc_x) ||
+        joystick_axis(a->adc_y) != joystick_axis(b->adc_y) || a->buttons != b->buttons;
+}
+
+// the inputs of one timer pass, live or from the trace; key is what the
+// expander queue reported. Returns 1 on the first pass of a replay,
+// when the listener goes back to where the trace started.
+static int input_read(struct input_event *in, int key)
+{
+    if (input_mode == INPUT_REPLAY) {
+        if (input_pass < input_end) {
+            // the first event is always at pass 0
+            while (input_next < input_len && input_trace[input_next].pass <= input_pass)
+                input_next++;
+            *in = input_trace[input_next - 1];
+            return input_pass++ == 0;
+        }
+        input_mode = INPUT_LIVE;
     }
-    // construction site
-    tft_fillTriangle(40, 140, 40, 180, 75, 160, ILI9340_ORANGE);
-    tft_fillRect(43, 158, 4, 4, ILI9340_BLACK);
-    tft_fillRect(50, 158, 18, 4, ILI9340_BLACK);
-    // bird
-    tft_fillTriangle(61, 109, 67, 108, 64, 116, ILI9340_BROWN);
-    tft_fillCircle(64, 102, 7, ILI9340_YELLOW);
-    tft_fillCircle(65, 101, 2, ILI9340_BLACK);
-}
-
-void fix_map(void) {
-    int ix, iy;
-    // cross walk
-    for (ix = 82; ix < 160; ix = ix + 10) {
-        tft_fillRect(ix, 100, 5, 20, ILI9340_WHITE);
-        tft_fillRect(ix, 200, 5, 20, ILI9340_WHITE);
+    in->adc_y = ReadADC10(0);
+    in->adc_x = ReadADC10(1);
+    in->buttons = (mPORTBReadBits(BIT_7)? 0 : INPUT_BUTTON) | (key? INPUT_KEY : 0);
+    if (input_mode == INPUT_RECORD) {
+        if (input_len == 0 || input_differs(&input_trace[input_len - 1], in)) {
+            // a full trace ends here
+            if (input_len == INPUT_EVENTS) {
+                input_mode = INPUT_LIVE;
+                return 0;
+            }
+            in->pass = input_pass;
+            input_trace[input_len++] = *in;
+        }
+        input_end = ++input_pass;
+        // the pass count is 16 bits in a trace
+        if (input_pass == 0xffff) input_mode = INPUT_LIVE;
     }
-    tft_fillCircle(120, 112, 8, ILI9340_GREEN);
-    // middle line
-    for (iy = 0; iy < 100; iy = iy + 10) {
-        tft_fillRect(119, iy, 2, 5, ILI9340_WHITE);
+    return 0;
+}
+
+static void input_record(void)
+{
+    input_mode = INPUT_RECORD;
+    input_len = 0;
+    input_pass = input_end = 0;
+    input_start_x = Accum2int(xpos);
+    input_start_y = Accum2int(ypos);
+}
+
+// replays need a trace that starts where the scene lets the listener be
+static void input_replay(void)
+{
+    if (input_len == 0 || !scene_walkable(&scene, input_start_x, input_start_y)) return;
+    input_mode = INPUT_REPLAY;
+    input_pass = 0;
+    input_next = 0;
+}
+
+// FRAME_INPUT frame of the trace with events from first on
+static void input_frame(struct frame *f, int seq, int first)
+{
+    const struct input_event *e;
+    frame_begin(f, FRAME_INPUT, seq);
+    frame_put16(f, input_start_x);
+    frame_put16(f, input_start_y);
+    frame_put16(f, input_end);
+    frame_put8(f, first);
+    frame_put8(f, input_len);
+    for (e = input_trace + first; e < input_trace + input_len &&
+            e < input_trace + first + INPUT_FRAME_EVENTS; e++) {
+        frame_put16(f, e->pass);
+        frame_put16(f, e->adc_x);
+        frame_put16(f, e->adc_y);
+        frame_put8(f, e->buttons);
     }
-    for (iy = 225; iy < 320; iy = iy + 10) {
-        tft_fillRect(119, iy, 2, 5, ILI9340_WHITE);
+    frame_end(f);
+}
+
+// an uploaded trace, in order from event 0 like a scene; it replaces
+// the one in RAM once its last event is in and checked
+static int input_receive(const unsigned char *payload, int len, int *bad)
+{
+    const unsigned char *p;
+    int first, total, n, i;
+    *bad = 0;
+    if (input_mode != INPUT_LIVE) return TUNE_BUSY;
+    if (len < INPUT_HEADER || (len - INPUT_HEADER) % INPUT_EVENT != 0) return TUNE_BAD_LENGTH;
+    first = payload[6];
+    total = payload[7];
+    n = (len - INPUT_HEADER)/INPUT_EVENT;
+    if (first == 0) input_rx_len = input_len = 0;
+    if (total == 0 || total > INPUT_EVENTS || first > input_rx_len || first + n > total)
+        return TUNE_BAD_VALUE;
+    for (i = 0, p = payload + INPUT_HEADER; i < n; i++, p += INPUT_EVENT) {
+        struct input_event *e = &input_trace[first + i];
+        e->pass = frame_get16(p);
+        e->adc_x = frame_get16(p+2);
+        e->adc_y = frame_get16(p+4);
+        e->buttons = p[6];
+        // from pass 0, in order
+        if (first + i == 0 ? e->pass != 0 : e->pass <= input_trace[first + i - 1].pass) {
+            *bad = first + i;
+            return TUNE_BAD_VALUE;
+        }
     }
+    if (first + n > input_rx_len) input_rx_len = first + n;
+    if (input_rx_len < total) return TUNE_OK;
+    input_start_x = frame_get16(payload);
+    input_start_y = frame_get16(payload+2);
+    input_end = frame_get16(payload+4);
+    if (input_end <= input_trace[total - 1].pass) return TUNE_BAD_VALUE;
+    input_len = total;
+    return TUNE_OK;
 }
 
 // === thread structures ============================================
@@ -442,7 +1382,81 @@ static struct pt pt_timer, pt_joystick;
 // system 1 second interval tick
 int sys_time_seconds;
 
+// move the listener one joystick step, if the scene lets it go there
+static void listener_move(int dx, int dy)
+{
+    int x = Accum2int(xpos) + dx, y = Accum2int(ypos) + dy;
+    if (!scene_walkable(&scene, x, y) || listener_on_source(x, y)) return;
+    xpos = int2Accum(x);
+    ypos = int2Accum(y);
+    map_update = 1;
+}
+
 // === Timer Thread =================================================
+// one pass of the timer thread, every 500 mSec; host_sim calls it
+// directly to replay an input trace
+static void timer_pass(void)
+{
+    struct input_event in;
+    unsigned int ev;
+    int key_update = 0, tune_update = 0;
+    sys_time_seconds++ ;
+    // expander key Y0 does the same as the joystick button
+    while (spsc_get(&key_queue, &ev))
+        if (KEY_NUM(ev) == 0 && KEY_DOWN(ev)) key_update = 1;
+    //******** Joystick + Map Stuff ****************** //
+    tft_fillCircle(Accum2int(xpos), Accum2int(ypos), 4, ILI9340_BLACK); 
+    // read ADC value, or what was recorded for this pass
+    if (input_read(&in, key_update)) {
+        xpos = int2Accum(input_start_x);
+        ypos = int2Accum(input_start_y);
+        map_update = 1;
+        tune_update = 1;
+    }
+    // determines if there is movement; the scene bounds the roads
+    // and blocks the car region
+    if (joystick_axis(in.adc_y)) listener_move(0, joystick_axis(in.adc_y)*scene.step);
+    if (joystick_axis(in.adc_x)) listener_move(joystick_axis(in.adc_x)*scene.step, 0);
+    // a scene uploaded over the serial port: new map and sources,
+    // the listener back at its start
+    if (scene_ready) {
+        scene_ready = 0;
+        scene = scene_next;
+        // records queued for the old scene
+        tune_count = 0;
+        xpos = int2Accum(scene.start_x);
+        ypos = int2Accum(scene.start_y);
+        spatial_grid_init();
+        occlusion_reset();
+        motion_reset();
+        tft_fillScreen(ILI9340_GRAY);
+        scene_draw(&scene, 0);
+        tune_update = 1;
+    }
+    // tuning commands from the serial port, all in this pass
+    if (tune_count) {
+        tune_update = 1;
+        if (tune_apply()) map_update = 1;
+    }
+    // update map and close Timer2 (audio output)
+    if (map_update == 1) {
+        CloseTimer2();
+        scene_draw(&scene, 1);
+        map_update = 0;
+    }
+    tft_fillCircle(Accum2int(xpos), Accum2int(ypos), 4, ILI9340_GREEN);
+    //******** Joystick + Map Stuff ****************** //
+    
+    //******** spatial audio ****************** //
+    // count the far ear notes the audio ISR reports as started
+    while (spsc_get(&started_queue, &ev)) far_note_count[NOTE_SOURCE(ev)]++;
+    // if joystick button pressed, update spatial audio calculation
+    if ((in.buttons & (INPUT_BUTTON | INPUT_KEY)) || tune_update) spatial_update();
+    // one ray of the buildings between the listener and the sources
+    occlusion_publish();
+    //******** spatial audio ****************** //
+}
+
 // update a 1 second tick counter
 static PT_THREAD (protothread_timer(struct pt *pt))
 {
@@ -450,189 +1464,345 @@ static PT_THREAD (protothread_timer(struct pt *pt))
       while(1) {
         // yield time 500ms
         PT_YIELD_TIME_msec(500) ;
-        sys_time_seconds++ ;
-        //******** Joystick + Map Stuff ****************** //
-        static int adc11_x, adc5_y;
-        // read ADC value
-        adc5_y = ReadADC10(0);   
-        adc11_x = ReadADC10(1);   
-        tft_fillCircle(Accum2int(xpos), Accum2int(ypos), 4, ILI9340_BLACK); 
-        // determines if there is movement
-        if (adc5_y < 300 && adc5_y >= 0 && ypos > int2Accum(10)) {
-            ypos -= 10;
-            map_update = 1;
-            // avoid the car region
-            if (xpos < int2Accum(160) && xpos > int2Accum(120) && ypos < int2Accum(50)) {
-                ypos += 10;
+        timer_pass();
+        // !!!! NEVER exit while !!!!
+      } // END WHILE(1)
+  PT_END(pt);
+} // timer thread
+
+// === Motion Thread ================================================
+// sources on paths, see source motion
+static PT_THREAD (protothread_motion(struct pt *pt))
+{
+    PT_BEGIN(pt);
+      while(1) {
+        PT_YIELD_TIME_msec(MOTION_MSEC);
+        motion_step();
+      }
+  PT_END(pt);
+}
+
+// === Key Thread ===================================================
+// sleeps until the expander interrupts, then reads it until the keys
+// have been still for a debounce interval; see pe_keys.h
+static PT_THREAD (protothread_keys(struct pt *pt))
+{
+    PT_BEGIN(pt);
+      while(1) {
+        PT_YIELD_UNTIL_IRQ(pt, pe_keys_irq);
+        pe_keys_irq = 0;
+        // the first burst releases INT, the change itself is not stable yet
+        pe_keys_read();
+        do {
+            PT_YIELD_TIME_msec(PE_KEY_DEBOUNCE_msec);
+        } while (!pe_keys_read());
+        pe_keys_arm();
+      } // END WHILE(1)
+  PT_END(pt);
+} // key thread
+
+// PT_send_buffer and DMA channel 1 are shared by every thread that prints
+static int uart_tx_busy;
+#define UART_TX_LOCK(pt) \
+    do { PT_YIELD_UNTIL(pt, !uart_tx_busy); uart_tx_busy = 1; } while(0)
+#define UART_TX_UNLOCK() (uart_tx_busy = 0)
+// ISR profile reports on/off
+static int prof_report;
+// binary telemetry frames on/off, and the telemetry period
+static int tlm_binary;
+static unsigned int tlm_period_msec = 1000;
+// a telemetry frame is on the wire for about 13 mSec at 115200 baud;
+// the cpu it costs sets the floor, see below
+#define TLM_PERIOD_MIN_msec 40
+// the bytes of one received frame come within this time
+#define FRAME_RX_msec 50
+
+// === Serial Thread ================================================
+// "s" prints the run time statistics of every scheduled thread,
+// one line per thread, times in microseconds, followed by the percent
+// of time the cpu was idle and the worst cost of the audio ISR queues;
+// "r" clears them; "p" turns the ISR profile reports on and off;
+// "b" turns the binary telemetry frames on and off; "t 100" sets the
+// telemetry period in mSec, TLM_PERIOD_MIN_msec at least. Lines are not
+// echoed.
+// A line that starts with FRAME_SYNC0 is a binary frame instead; see
+// live tuning above. Everything arrives by DMA on channel 0.
+static PT_THREAD (protothread_serial(struct pt *pt))
+{
+    static int i, n, status;
+    static struct ptx *p;
+    static unsigned char rx[3 + max_chars];
+    static struct frame ack;
+    static unsigned int ack_seq;
+    PT_BEGIN(pt);
+      while(1) {
+        // wait for the first byte of a frame or a line
+        PT_terminate_char = 0;
+        PT_terminate_count = 1;
+        PT_terminate_time = 0;
+        PT_SPAWN(pt, &pt_DMA_input, PT_GetMachineBuffer(&pt_DMA_input));
+        if ((unsigned char)PT_term_buffer[0] == FRAME_SYNC0) {
+            // sync, type, seq, len, then the payload and CRC; a frame
+            // that stalls is dropped and the hunt for a sync restarts
+            PT_terminate_count = 4;
+            PT_terminate_time = FRAME_RX_msec;
+            PT_SPAWN(pt, &pt_DMA_input, PT_GetMachineBuffer(&pt_DMA_input));
+            if (PT_timeout || (unsigned char)PT_term_buffer[0] != FRAME_SYNC1) continue;
+            memcpy(rx, PT_term_buffer+1, 3);
+            n = rx[2];
+            if (n + 2 > max_chars) continue;
+            PT_terminate_count = n + 2;
+            PT_SPAWN(pt, &pt_DMA_input, PT_GetMachineBuffer(&pt_DMA_input));
+            if (PT_timeout) continue;
+            memcpy(rx+3, PT_term_buffer, n + 2);
+            if (frame_crc16(rx, n + 3) != frame_get16(rx + 3 + n)) continue;
+            if (rx[0] == FRAME_COMMAND) status = tune_accept(rx+3, n, &i);
+            else if (rx[0] == FRAME_SCENE) status = scene_receive(rx+3, n, &i);
+            else if (rx[0] == FRAME_INPUT) status = input_receive(rx+3, n, &i);
+            else { status = TUNE_BAD_TYPE; i = 0; }
+            frame_begin(&ack, FRAME_ACK, ack_seq++);
+            frame_put8(&ack, rx[1]);
+            frame_put8(&ack, status);
+            frame_put8(&ack, i);
+            frame_end(&ack);
+            UART_TX_LOCK(pt);
+            PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBinary(&pt_DMA_output, ack.buf, ack.len));
+            UART_TX_UNLOCK();
+            continue;
+        }
+        // a command line: the rest of it, up to <enter>
+        if (PT_term_buffer[0] != '\r') {
+            rx[0] = PT_term_buffer[0];
+            PT_terminate_char = '\r';
+            PT_terminate_count = 0;
+            PT_SPAWN(pt, &pt_DMA_input, PT_GetMachineBuffer(&pt_DMA_input));
+            memmove(PT_term_buffer+1, PT_term_buffer, max_chars-1);
+            PT_term_buffer[0] = rx[0];
+        }
+        if (PT_term_buffer[0] == 's') {
+            UART_TX_LOCK(pt);
+            for (i = 0; i < pt_task_count; i++) {
+                p = &pt_thread_list[i];
+                snprintf(PT_send_buffer, max_chars, "%d n=%u min=%u max=%u avg=%u ovr=%u miss=%u\n\r",
+                    i, p->run_count,
+                    p->run_count ? p->run_min/PT_TICKS_PER_usec : 0,
+                    p->run_max/PT_TICKS_PER_usec,
+                    PT_GET_MEAN(i)/PT_TICKS_PER_usec,
+                    p->overruns, p->missed);
+                // send by DMA so the dump does not stall the other threads
+                PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBuffer(&pt_DMA_output));
             }
+            // cost of the ISR queues, in core timer ticks
+            snprintf(PT_send_buffer, max_chars, "idle=%u%% queue=%u\n\r",
+                PT_IDLE_PERCENT(), queue_ticks_max);
+            PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBuffer(&pt_DMA_output));
+            UART_TX_UNLOCK();
         }
-        if (adc5_y > 600 && adc5_y <= 1023 && ypos < int2Accum(310)) {
-            ypos += 10;
-            map_update = 1;
+        else if (PT_term_buffer[0] == 'p') {
+            prof_report = !prof_report;
         }
-        if (adc11_x < 300 && adc11_x >= 0 && xpos > int2Accum(90)) {
-            xpos -= 10; 
-            map_update = 1;
+        else if (PT_term_buffer[0] == 'b') {
+            tlm_binary = !tlm_binary;
         }
-        if (adc11_x > 600 && adc11_x <= 1023 && xpos < int2Accum(150)) {
-            xpos += 10;
-            map_update = 1;
-            // avoid the car region
-            if (xpos < int2Accum(160) && xpos > int2Accum(120) && ypos < int2Accum(50)) {
-                xpos -= 10;
-            }
+        else if (PT_term_buffer[0] == 't') {
+            i = atoi(PT_term_buffer+1);
+            if (i >= TLM_PERIOD_MIN_msec) tlm_period_msec = i;
         }
-        // update map and close Timer2 (audio output)
-        if (map_update == 1) {
-            CloseTimer2();
-            fix_map();
-            map_update = 0;
+        else if (PT_term_buffer[0] == 'r') {
+            for (i = 0; i < pt_task_count; i++) PT_STATS_RESET(i);
+            PT_IDLE_RESET();
+            queue_ticks_max = 0;
         }
-        tft_fillCircle(Accum2int(xpos), Accum2int(ypos), 4, ILI9340_GREEN);
-        //******** Joystick + Map Stuff ****************** //
-        
-        //******** spatial audio ****************** //
-        // if joystick button pressed, update spatial audio calculation
-        if (!mPORTBReadBits(BIT_7)) {
-            // bird spatial audio calibration
-            x_diff = bird_x-Accum2int(xpos);
-            y_diff = bird_y-Accum2int(ypos);
-            tan_value = (double)(abs(x_diff))/(double)(abs(y_diff));
-            angle_rad = atan(tan_value);
-            // amplitude ratio & delay calculation, used in timer 3/4/5 interrupt for the further channel
-            amplitude_ratio = cos(angle_rad);
-            delay = head_radius*(angle_rad + sin(angle_rad))/sound_speed;
-            timer3_delay = (int)(40000000 * delay);
-            // intensity decay tuning -- customized for each audio source
-            intensity_diff = (10 * log(sqrt((x_diff*x_diff)+(y_diff*y_diff))/6) / log(10)) - 2;
-            max_amplitude = global_max_amplitude - (_Accum)(intensity_diff);
-            if (max_amplitude < 0) max_amplitude = 0;
-            else if (max_amplitude > 12) max_amplitude = 12;
-            if (x_diff > 0) {
-                // sound source on the right
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                left = 1;
-                max_amplitude_right = max_amplitude;
-                attack_inc_right = (max_amplitude_right-threshold_amplitude)/(_Accum)attack_time_right;
-                decay_inc_right = (max_amplitude_right-threshold_amplitude)/(_Accum)decay_time_right;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                note_time_right = 0;
-            } else {
-                // sound source on the left
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                left = 0;
-                max_amplitude_left = max_amplitude;
-                attack_inc_left = (max_amplitude_left-threshold_amplitude)/(_Accum)attack_time_left;
-                decay_inc_left = (max_amplitude_left-threshold_amplitude)/(_Accum)decay_time_left;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                note_time_left = 0;
-            }
-             
-            // car spatial audio calibration
-            car_x_diff = car_x-Accum2int(xpos);
-            car_y_diff = car_y-Accum2int(ypos);
-            car_tan_value = (double)(abs(car_x_diff))/(double)(abs(car_y_diff));
-            car_angle_rad = atan(car_tan_value);
-            // amplitude ratio & delay calculation, used in timer 3/4/5 interrupt for the further channel
-            car_amplitude_ratio = cos(car_angle_rad);
-            car_delay = head_radius*(car_angle_rad + sin(car_angle_rad))/sound_speed;
-            timer4_delay = (int)(40000000 * car_delay);
-            // intensity decay tuning -- customized for each audio source
-            car_intensity_diff = (150 * log(sqrt((car_x_diff*car_x_diff)+(car_y_diff*car_y_diff))/20) / log(10));
-            max_car_amplitude = global_max_car_amplitude - (_Accum)(car_intensity_diff);
-            if (max_car_amplitude < 0) max_car_amplitude = 0;
-            else if (max_car_amplitude > 180) max_car_amplitude = 180;
-            if (car_x_diff > 0) {
-                // sound source on the right
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                car_left = 1;
-                max_car_amplitude_right = max_car_amplitude;
-                car_attack_inc_right = (max_car_amplitude_right-threshold_amplitude)/(_Accum)car_attack_time_right;
-                car_decay_inc_right = (max_car_amplitude_right-threshold_amplitude)/(_Accum)car_decay_time_right;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                car_note_time_right = 0;
-            } else {
-                // sound source on the left
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                car_left = 0;
-                max_car_amplitude_left = max_car_amplitude;
-                car_attack_inc_left = (max_car_amplitude_left-threshold_amplitude)/(_Accum)car_attack_time_left ;
-                car_decay_inc_left = (max_car_amplitude_left-threshold_amplitude)/(_Accum)car_decay_time_left ;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                car_note_time_left = 0;
-            }
-            
-            // bell spatial audio calibration
-            bell_x_diff = bell_x-Accum2int(xpos);
-            bell_y_diff = bell_y-Accum2int(ypos);
-            bell_tan_value = (double)(abs(bell_x_diff))/(double)(abs(bell_y_diff));
-            bell_angle_rad = atan(bell_tan_value);
-            // amplitude ratio & delay calculation, used in timer 3/4/5 interrupt for the further channel
-            bell_amplitude_ratio = cos(bell_angle_rad);
-            bell_delay = head_radius*(bell_angle_rad + sin(bell_angle_rad))/sound_speed;
-            timer5_delay = (int)(40000000 * bell_delay);
-            // intensity decay tuning -- customized for each audio source
-            bell_intensity_diff = (15 * log(sqrt((bell_x_diff*bell_x_diff)+(bell_y_diff*bell_y_diff))/6) / log(10)) - 1;
-            max_bell_amplitude = global_max_bell_amplitude - (_Accum)(bell_intensity_diff);
-            if (max_bell_amplitude < 0) max_bell_amplitude = 0;
-            else if (max_bell_amplitude > 18) max_bell_amplitude = 18;
-            if (bell_x_diff > 0) {
-                // sound source on the right
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                bell_left = 1;
-                max_bell_amplitude_right = max_bell_amplitude;
-                bell_attack_inc_right = (max_bell_amplitude_right-bell_threshold_amplitude)/(_Accum)bell_attack_time_right;
-                bell_decay_inc_right = (max_bell_amplitude_right-bell_threshold_amplitude)/(_Accum)bell_decay_time_right;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                bell_note_time_right = 0;
-            } else {
-                // sound source on the left
-                // perform spatial audio amplitude ratio tuning
-                // calculate the amplitude change per sample during attack and decay
-                bell_left = 0;
-                max_bell_amplitude_left = max_bell_amplitude;
-                bell_attack_inc_left = (max_bell_amplitude_left-bell_threshold_amplitude)/(_Accum)bell_attack_time_left;
-                bell_decay_inc_left = (max_bell_amplitude_left-bell_threshold_amplitude)/(_Accum)bell_decay_time_left;
-                // set note time to 0 to enable audio; the further channel is enabled after the delay
-                bell_note_time_left = 0;
+        else if (PT_term_buffer[0] == 'i') {
+            // input trace: record, stop, play or dump
+            for (i = 1; PT_term_buffer[i] == ' '; i++) ;
+            switch (PT_term_buffer[i]) {
+            case 'r': input_record(); break;
+            case 's': input_mode = INPUT_LIVE; break;
+            case 'p': input_mode = INPUT_LIVE; input_replay(); break;
+            case 'd':
+                // a recording is cut short by its dump
+                if (input_mode == INPUT_RECORD) input_mode = INPUT_LIVE;
+                UART_TX_LOCK(pt);
+                for (n = 0; n == 0 || n < input_len; n += INPUT_FRAME_EVENTS) {
+                    input_frame(&ack, ack_seq++, n);
+                    PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBinary(&pt_DMA_output, ack.buf, ack.len));
+                }
+                UART_TX_UNLOCK();
+                break;
             }
-            
-            // timer interrupt
-            // Set up timer2 on for DAC
-            // at 40 MHz PB clock; timer value = 40,000,000/Fs
-            OpenTimer2(T2_ON | T2_SOURCE_INT | T2_PS_1_1, 2667);
-            // set up the timer interrupt with a priority of 2
-            ConfigIntTimer2(T2_INT_ON | T2_INT_PRIOR_2);
-            mT2ClearIntFlag(); // and clear the interrupt flag
-            // Timer 3 Setup -- bird audio delay tuning
-            OpenTimer3(T3_ON | T3_SOURCE_INT | T3_PS_1_1, timer3_delay);
-            // set up the timer interrupt with a priority of 1
-            ConfigIntTimer3(T3_INT_ON | T3_INT_PRIOR_1);
-            mT3ClearIntFlag(); // and clear the interrupt flag
-            // Timer 4 Setup -- car audio delay tuning
-            OpenTimer4(T4_ON | T4_SOURCE_INT | T4_PS_1_1, timer4_delay);
-            // set up the timer interrupt with a priority of 1
-            ConfigIntTimer4(T4_INT_ON | T4_INT_PRIOR_1);
-            mT4ClearIntFlag(); // and clear the interrupt flag
-            // Timer 5 Setup -- bell audio delay tuning
-            OpenTimer5(T5_ON | T5_SOURCE_INT | T5_PS_1_1, timer5_delay);
-            // set up the timer interrupt with a priority of 1
-            ConfigIntTimer5(T5_INT_ON | T5_INT_PRIOR_1);
-            mT5ClearIntFlag(); // and clear the interrupt flag
         }
-        //******** spatial audio ****************** //
-
         // !!!! NEVER exit while !!!!
       } // END WHILE(1)
   PT_END(pt);
-} // timer thread
+} // serial thread
+
+// === binary telemetry ==============================================
+// One FRAME_TELEMETRY frame (see serial_frame.h) per telemetry period;
+// host/telemetry.py decodes and plots them. Payload, little endian:
+//   u8  version               TLM_VERSION
+//   u32 time                  mSec since reset
+//   u16 interval              mSec the ISR and DAC figures cover
+//   u16 x, y                  listener position
+//   per source (bird, car, bell):
+//     u8  far ear             0 left, 1 right
+//     u16 peak                near ear amplitude, 8.8 fixed point
+//     u16 gain                far/near amplitude ratio, 1.15 fixed point
+//     u16 itd                 far ear delay in peripheral clocks
+//   per ISR vector (T2, T3, T4, T5, INT2):
+//     u16 cpu                 in 0.01%
+//     u16 max                 longest run in peripheral clocks
+//     u16 late, overrun
+//   u8  idle                  scheduler idle percent
+//   u8  threads               then per thread:
+//     u16 max                 longest dispatch in uSec
+//     u16 overruns, missed
+//   u16 dac min, max          left ear, then right ear
+//   u16 queue                 worst Timer2 queue cost in core ticks
+// The frame costs the thread about 10k cycles, the UART is fed by DMA:
+// 25 frames a second at TLM_PERIOD_MIN_msec are 0.39% of the 64 MHz
+// cpu. The DAC range costs Timer2 a dozen cycles at each of its 23988
+// samples a second, 0.45%, whether frames are sent or not. Together
+// they stay under 1%; at 20 mSec the frames alone would be 0.78%.
+#define TLM_VERSION 1
+static struct frame tlm_frame;
+static unsigned int tlm_seq;
+#define TLM_U16(v) ((v) > 0xffff ? 0xffff : (v))
+
+static void tlm_put_source(struct frame *f, int s)
+{
+    frame_put8(f, DBUF_FRONT(spatial)->src[s].far_ear);
+    frame_put16(f, (unsigned int)(Accum2float(source_peak[s])*256));
+    frame_put16(f, (unsigned int)(source_ratio[s]*32767));
+    frame_put16(f, TLM_U16(source_itd[s]));
+}
+
+// build the frame from the ISR stats of the last interval (core ticks)
+static void tlm_frame_build(struct isr_prof *prof, unsigned int interval)
+{
+    struct frame *f = &tlm_frame;
+    struct dac_peak peak;
+    unsigned int status, cpu;
+    int i;
+    // DAC range since the last frame
+    status = INTDisableInterrupts();
+    peak = dac_peak;
+    dac_peak.min[LEFT_EAR] = dac_peak.min[RIGHT_EAR] = 4095;
+    dac_peak.max[LEFT_EAR] = dac_peak.max[RIGHT_EAR] = 0;
+    INTRestoreInterrupts(status);
+    
+    frame_begin(f, FRAME_TELEMETRY, tlm_seq++);
+    frame_put8(f, TLM_VERSION);
+    frame_put32(f, PT_GET_TIME());
+    frame_put16(f, TLM_U16(interval/(PT_TICKS_PER_usec*1000)));
+    frame_put16(f, Accum2int(xpos));
+    frame_put16(f, Accum2int(ypos));
+    for (i = 0; i < NUM_SOURCES; i++) tlm_put_source(f, i);
+    for (i = 0; i < PROF_VECTORS; i++) {
+        cpu = interval ? (unsigned int)(prof[i].total*10000/interval) : 0;
+        frame_put16(f, TLM_U16(cpu));
+        frame_put16(f, TLM_U16(prof[i].max*ISR_PROF_PB_PER_TICK));
+        frame_put16(f, TLM_U16(prof[i].late));
+        frame_put16(f, TLM_U16(prof[i].overrun));
+    }
+    frame_put8(f, PT_IDLE_PERCENT());
+    frame_put8(f, pt_task_count);
+    for (i = 0; i < pt_task_count; i++) {
+        frame_put16(f, TLM_U16(pt_thread_list[i].run_max/PT_TICKS_PER_usec));
+        frame_put16(f, TLM_U16(pt_thread_list[i].overruns));
+        frame_put16(f, TLM_U16(pt_thread_list[i].missed));
+    }
+    frame_put16(f, peak.min[LEFT_EAR]);
+    frame_put16(f, peak.max[LEFT_EAR]);
+    frame_put16(f, peak.min[RIGHT_EAR]);
+    frame_put16(f, peak.max[RIGHT_EAR]);
+    frame_put16(f, TLM_U16(queue_ticks_max));
+    frame_end(f);
+}
+
+// === Telemetry Thread =============================================
+// Every telemetry period the ISR stats are collected and cleared, and
+// with "b" on a binary frame goes out. With reports on, each vector
+// that ran prints three lines, in peripheral clocks (Timer2
+// has SAMPLE_PERIOD of them per sample):
+//   T2 n=24000 min=610 avg=702 max=1410 cpu=26%
+//   T2 late=0 ovr=0
+//   T2 hist 32 60 7 1 0 0 0 0 0 0 0 0 0 0 0 0
+// late/ovr only apply to Timer2; the histogram is the percent of runs
+// in each bin of ISR_PROF_BIN_TICKS core ticks, the last bin is open
+static PT_THREAD (protothread_telemetry(struct pt *pt))
+{
+    static int v;
+    static unsigned int interval_start, interval;
+    static struct isr_prof prof[PROF_VECTORS];
+    static struct isr_prof *q;
+    static unsigned int *h, pct[ISR_PROF_BINS];
+    int k;
+    PT_BEGIN(pt);
+      interval_start = ReadCoreTimer();
+      while(1) {
+        PT_YIELD_TIME_msec(tlm_period_msec);
+        interval = ReadCoreTimer() - interval_start;
+        interval_start += interval;
+        for (v = 0; v < PROF_VECTORS; v++) isr_prof_snapshot(&isr_prof[v], &prof[v], 1);
+        if (tlm_binary) {
+            tlm_frame_build(prof, interval);
+            UART_TX_LOCK(pt);
+            PT_SPAWN(pt, &pt_DMA_output,
+                PT_DMA_PutSerialBinary(&pt_DMA_output, tlm_frame.buf, tlm_frame.len));
+            UART_TX_UNLOCK();
+        }
+        if (!prof_report) continue;
+        
+        UART_TX_LOCK(pt);
+        for (v = 0; v < PROF_VECTORS; v++) {
+            q = &prof[v];
+            if (q->count == 0) continue;
+            snprintf(PT_send_buffer, max_chars, "%s n=%u min=%u avg=%u max=%u cpu=%u%%\n\r",
+                prof_name[v], q->count,
+                q->min*ISR_PROF_PB_PER_TICK,
+                (unsigned int)(q->total/q->count)*ISR_PROF_PB_PER_TICK,
+                q->max*ISR_PROF_PB_PER_TICK,
+                (unsigned int)(q->total*100/interval));
+            PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBuffer(&pt_DMA_output));
+            snprintf(PT_send_buffer, max_chars, "%s late=%u ovr=%u\n\r",
+                prof_name[v], q->late, q->overrun);
+            PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBuffer(&pt_DMA_output));
+            for (k = 0; k < ISR_PROF_BINS; k++) pct[k] = q->hist[k]*100/q->count;
+            h = pct;
+            snprintf(PT_send_buffer, max_chars,
+                "%s hist %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u\n\r",
+                prof_name[v], h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                h[8], h[9], h[10], h[11], h[12], h[13], h[14], h[15]);
+            PT_SPAWN(pt, &pt_DMA_output, PT_DMA_PutSerialBuffer(&pt_DMA_output));
+        }
+        UART_TX_UNLOCK();
+      } // END WHILE(1)
+  PT_END(pt);
+} // telemetry thread
 
 
+// === audio setup ==================================================
+// everything the synthesis needs before the first spatial_update
+static void audio_init(void)
+{
+    int i;
+    // build the sine lookup table
+    // scaled to produce values between 0 and 4096
+    for (i = 0; i < sine_table_size; i++){
+        sine_table[i] = (_Accum)(sin((float)i*6.283/(float)sine_table_size));
+    }
+    // the far ears start unfiltered
+    for (i = 0; i < NUM_SOURCES; i++) shadow[i].k = shadow[i].target = HS_OPEN;
+    reverb_init();
+    // the scene compiled into flash; host/scene.py checked it, but a bad
+    // one would leave no sources and nowhere to walk rather than crash
+    scene_load(&scene, scene_default, scene_default_len);
+    xpos = int2Accum(scene.start_x);
+    ypos = int2Accum(scene.start_y);
+    spatial_grid_init();
+}
+
 // === Main  ======================================================
 void main(void) {
  //SYSTEMConfigPerformance(PBCLK);
@@ -645,27 +1815,21 @@ void main(void) {
     CloseTimer5();
 
     // SCK2 is pin 26 
-    // SDO2 (MOSI) is in PPS output group 2, could be connected to RB5 which is pin 14
-    PPSOutput(2, RPB5, SDO2);
-
     // control CS for DAC
     mPORTBSetPinsDigitalOut(BIT_4);
     mPORTBSetBits(BIT_4);
 
-    // open SPI channel2 for DAC audio output
-    // divide Fpb by 2, configure the I/O ports. Not using SS in this example
-    // 16 bit transfer CKP=1 CKE=1
-    // possibles SPI_OPEN_CKP_HIGH;   SPI_OPEN_SMP_END;  SPI_OPEN_CKE_REV
-    // For any given peripherial, you will need to match these
-    // clk divider set to 4 for 10 MHz
-    SpiChnOpen(SPI_CHANNEL2, SPI_OPEN_ON | SPI_OPEN_MODE16 | SPI_OPEN_MSTEN | SPI_OPEN_CKE_REV , 4);
+    // open SPI channel2 for DAC audio output, SDO2 on RB5 (pin 14)
+    // 16 bit transfer CKP=1 CKE=1, clk divider set to 4
+    // the port expander shares the channel through the bus manager
+    spi2_bus_init();
+    // the expander on the same bus, port Y pins are keys
+    initPE();
+    pe_keys_init(0x00ff);
     
-   // build the sine lookup table
-   // scaled to produce values between 0 and 4096
-   int i;
-   for (i = 0; i < sine_table_size; i++){
-        sine_table[i] = (_Accum)(sin((float)i*6.283/(float)sine_table_size));
-    }
+    // sine table and sound sources
+    audio_init();
+    int i;
     
     // init the display
     // NOTE that this init assumes SPI channel 1 connections
@@ -711,15 +1875,11 @@ void main(void) {
 
 	EnableADC10(); // Enable the ADC
   
-    // hardcoded sound source positions
-    bird_x = 80;
-    bird_y = 120;
-    car_x = 142;
-    car_y = 25;
-    bell_x = 183;
-    bell_y = 221;
     // initialize the maps
-    collegetown_map();
+    scene_draw(&scene, 0);
+    
+    // ISR stats start empty
+    for (i = 0; i < PROF_VECTORS; i++) isr_prof_reset(&isr_prof[i]);
     
     // === setup system wide interrupts  ========
     INTEnableSystemMultiVectoredInt();
@@ -729,11 +1889,20 @@ void main(void) {
     PT_setup();
 
     // init the threads
-    PT_INIT(&pt_timer);
+    // the scheduler times every dispatch for the serial stats dump
+    int timer_thread = pt_add(protothread_timer, 0);
+    pt_add(protothread_serial, 0);
+    pt_add(protothread_keys, 0);
+    pt_add(protothread_telemetry, 0);
+    pt_add(protothread_motion, 0);
+    // the timer thread redraws the map; more than 20 mSec is an overrun
+    PT_SET_BUDGET(timer_thread, 20000);
+    PT_INIT(&pt_sched);
+    pt_sched_method = SCHED_ROUND_ROBIN;
     
     // round-robin scheduler for threads
     while (1){
-        PT_SCHEDULE(protothread_timer(&pt_timer));
+        PT_SCHEDULE(protothread_sched(&pt_sched));
     }
 } // main
 
@@ -39,6 +39,10 @@
 #define use_uart_serial
 // BAUDRATE must match PC terminal emulator setting
 #define BAUDRATE  115200 
+//=== ISR profiler =============================================
+// IF use_isr_profiler IS defined, the audio and delay ISRs time
+// themselves; see isr_prof.h
+#define use_isr_profiler
 //==============================================================
 
 #endif	/* CONFIG_H */
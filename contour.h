@@ -0,0 +1,90 @@
+/*
+ * File:   contour.h
+ * Breakpoint pitch and level contours for synthesized voices, from flash
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef CONTOUR_H
+#define	CONTOUR_H
+/* A contour voice is a sine whose pitch and level follow two lists of
+ * breakpoints, written in a text file and converted by host/contour.py
+ * into contour_bank.c. Between two breakpoints a contour is a straight
+ * line or a quadratic bend, so it is worked out by forward differences:
+ * each sample adds the slope to the value and the curve to the slope,
+ * two integer adds whatever the shape. A segment of the bank is
+ *   length     samples, at least 1
+ *   value      at its first sample
+ *   slope      added after the first sample
+ *   curve      added to the slope after every sample
+ * all in 1/CONTOUR_ONE Hz for pitch and 1/CONTOUR_ONE of full scale
+ * for level, with CONTOUR_FRAC more fractional bits so a bend over a
+ * few seconds still lands on its breakpoint; the value is its high
+ * word. After the last segment a contour goes back to segment loop, or
+ * holds its last value if loop is -1.
+ */
+
+#define CONTOUR_ONE 65536
+#define CONTOUR_SHIFT 16
+#define CONTOUR_FRAC 32
+// a level, shifted down to 15 bits, as the sine table's 1.0
+#define CONTOUR_LEVEL_ONE ((_Accum)(1.0/32768))
+
+struct contour_seg {
+    unsigned int length;
+    long long value, slope, curve;
+};
+
+struct contour {
+    const struct contour_seg *seg;
+    unsigned short segs;
+    short loop;                         // segment to go back to, or -1
+};
+
+struct contour_voice {
+    struct contour pitch, level;
+};
+
+// the contours compiled into flash
+extern const struct contour_voice contour_bank[];
+extern const int contour_bank_len;
+
+// one run through a contour
+struct contour_state {
+    unsigned int left;                  // samples to the next segment
+    long long value, slope, curve;
+    unsigned short seg;                 // the next segment
+};
+
+// from the first breakpoint at the next contour_next
+static inline void contour_start(struct contour_state *st)
+{
+    st->left = 0;
+    st->seg = 0;
+}
+
+/* The next value, in 1/CONTOUR_ONE. Two 64 bit adds and a count down,
+ * the loads of a segment header at its first sample. */
+static inline int contour_next(struct contour_state *st, const struct contour *c)
+{
+    const struct contour_seg *g;
+    if (st->left) {
+        st->left--;
+        st->value += st->slope;
+        st->slope += st->curve;
+    } else if (st->seg < c->segs) {
+        g = &c->seg[st->seg];
+        st->left = g->length - 1;
+        st->value = g->value;
+        st->slope = g->slope;
+        st->curve = g->curve;
+        st->seg = (st->seg + 1 == c->segs && c->loop >= 0)? c->loop : st->seg + 1;
+    } else {
+        // past the end: the last value from now on
+        st->left = ~0u;
+        st->slope = st->curve = 0;
+    }
+    return (int)(st->value >> CONTOUR_FRAC);
+}
+
+#endif	/* CONTOUR_H */
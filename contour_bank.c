@@ -0,0 +1,50 @@
+// Generated by host/contour.py from voices.contour -- do not edit
+#include <stddef.h>
+#include "contour.h"
+
+// 0: bird
+static const struct contour_seg contour_0_pitch[] = {
+    {5720, 306909055606230848LL, 23479016130LL, 46958034436LL},
+    {1, 1075104932545419008LL, 0LL, 0LL},
+};
+static const struct contour_seg contour_0_level[] = {
+    {1, 281474976710656LL, 0LL, 0LL},
+};
+
+// 1: car
+static const struct contour_seg contour_1_pitch[] = {
+    {357, 45035996273705LL, 138324845697808LL, 0LL},
+    {357, 123848989752689LL, -220764687616LL, 0LL},
+};
+static const struct contour_seg contour_1_level[] = {
+    {1, 281474976710656LL, 0LL, 0LL},
+};
+
+// 2: bell
+static const struct contour_seg contour_2_pitch[] = {
+    {4500, 321182651675228224LL, 0LL, 0LL},
+    {4500, 254889665160334528LL, 0LL, 0LL},
+    {1, 254889665160334528LL, 0LL, 0LL},
+};
+static const struct contour_seg contour_2_level[] = {
+    {9000, 281474976710656LL, 0LL, 0LL},
+    {1, 0LL, 0LL, 0LL},
+};
+
+// 3: siren
+static const struct contour_seg contour_3_pitch[] = {
+    {12000, 168884986026393600LL, 32837379004317LL, -2736562274LL},
+    {12000, 365917469723852800LL, -8210370960023LL, -1368281137LL},
+};
+static const struct contour_seg contour_3_level[] = {
+    {6000, 140737488355328LL, 46908585684LL, -7818749LL},
+    {18000, 281474976710656LL, -433728LL, -868750LL},
+};
+
+const struct contour_voice contour_bank[] = {
+    {{contour_0_pitch, 2, -1}, {contour_0_level, 1, -1}},
+    {{contour_1_pitch, 2, 0}, {contour_1_level, 1, -1}},
+    {{contour_2_pitch, 3, -1}, {contour_2_level, 2, -1}},
+    {{contour_3_pitch, 2, 0}, {contour_3_level, 2, 0}},
+};
+const int contour_bank_len = 4;
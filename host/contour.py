@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Convert breakpoint contours into the contour bank of contour.h.
+
+    python3 contour.py voices.contour -o ../contour_bank.c
+
+One statement per line, '#' starts a comment:
+
+    contour NAME                    starts a voice, numbered in order
+      pitch T HZ [CURVE] [loop T0]  the pitch is HZ T samples into the note
+      level T L [CURVE] [loop T0]   and the level L, 0..1 of full scale
+
+A scene plays voice N with "voice contour N", shaped by the source's
+envelope like any other voice. Pitches are in Hz as heard, times in
+samples of the audio ISR, about 23988 a second. The first breakpoint
+of each contour is at T 0, and the times go up. Two breakpoints at the
+same time jump from one value to the other. CURVE bends the way to a
+breakpoint from the one before: 0 (the default) is a straight line, 1
+starts flat and ends steep, -1 starts steep and ends flat, anything
+between is a mix; it is a quadratic, so it never overshoots. loop T0
+on the last breakpoint goes back to the breakpoint at T0 once it is
+reached; a contour that does not loop holds its last value. A voice
+without level breakpoints plays at full scale.
+"""
+import argparse
+import sys
+
+# the segments of contour.h, CONTOUR_ONE << CONTOUR_FRAC
+ONE = 1 << 48
+LLONG_MAX = (1 << 63) - 1
+
+
+class ContourError(Exception):
+    pass
+
+
+def parse(text):
+    voices, voice = [], None
+    for number, line in enumerate(text.splitlines(), 1):
+        words = line.split('#')[0].split()
+        if not words:
+            continue
+        try:
+            key, args = words[0], words[1:]
+            if key == 'contour':
+                voice = {'name': args[0], 'pitch': [], 'level': [],
+                         'loop': {'pitch': None, 'level': None}}
+                voices.append(voice)
+            elif key in ('pitch', 'level'):
+                if voice is None:
+                    raise ContourError('%s outside a contour' % key)
+                if voice['loop'][key] is not None:
+                    raise ContourError('%s after its loop' % key)
+                rest = args[2:]
+                if 'loop' in rest:
+                    i = rest.index('loop')
+                    voice['loop'][key] = int(rest[i + 1])
+                    rest = rest[:i]
+                curve = float(rest[0]) if rest else 0.0
+                if not -1 <= curve <= 1:
+                    raise ContourError('a curve is -1..1')
+                voice[key].append((int(args[0]), float(args[1]), curve))
+            else:
+                raise ContourError('unknown statement %s' % key)
+        except (ValueError, IndexError) as e:
+            raise ContourError('line %d: %s (%s)' % (number, line.strip(), e))
+        except ContourError as e:
+            raise ContourError('line %d: %s' % (number, e))
+    return voices
+
+
+def segments(points, loop, high, limit):
+    """The (length, value, slope, curve) segments of one contour, the
+    segment loop goes back to, and the worst rounding error. Values are
+    0..high, and rounding must keep them below limit."""
+    if not points or points[0][0] != 0:
+        raise ContourError('the first breakpoint is at 0')
+    for t, v, _ in points:
+        if not 0 <= v <= high:
+            raise ContourError('%g at %d is not 0..%g' % (v, t, high))
+    segs, starts, worst = [], {}, 0.0
+    for (t0, a, _), (t1, b, c) in zip(points, points[1:]):
+        if t1 < t0:
+            raise ContourError('breakpoint at %d before %d' % (t1, t0))
+        if t1 == t0:
+            continue
+        n = t1 - t0
+        # v(k) = a + A*k + B*k^2, forward differences slope A + B and
+        # curve 2*B; the slope is cut short to land on b at k = n, not
+        # past it
+        curve = round(2 * (b - a) * c / (n * n) * ONE)
+        slope = int(((b - a) * ONE - curve * n * (n - 1) / 2) / n)
+        a_q = round(a * ONE)
+        for k in (0, n // 2, n):
+            exact = a + (b - a) * ((1 - c) * k / n + c * (k / n) ** 2)
+            got = (a_q + slope * k + curve * k * (k - 1) // 2) / ONE
+            worst = max(worst, abs(got - exact))
+            if not 0 <= got < limit:
+                raise ContourError('rounds to %g at %d' % (got, t0 + k))
+        if abs(slope) + abs(curve) * n > LLONG_MAX:
+            raise ContourError('too steep at %d' % t0)
+        starts.setdefault(t0, len(segs))
+        segs.append((n, a_q, slope, curve))
+    if loop is None:
+        # holds the last value
+        segs.append((1, round(points[-1][1] * ONE), 0, 0))
+        return segs, -1, worst
+    if loop not in starts:
+        raise ContourError('no segment starts at loop %d' % loop)
+    return segs, starts[loop], worst
+
+
+def c_source(voices, name):
+    lines = ['// Generated by host/contour.py from %s -- do not edit' % name,
+             '#include <stddef.h>',
+             '#include "contour.h"', '']
+    table = []
+    for n, v in enumerate(voices):
+        lines.append('// %d: %s' % (n, v['name']))
+        entry = []
+        for kind in ('pitch', 'level'):
+            segs, loop = v[kind]
+            lines.append('static const struct contour_seg contour_%d_%s[] = {' % (n, kind))
+            lines += ['    {%d, %dLL, %dLL, %dLL},' % s for s in segs]
+            lines += ['};']
+            entry.append('{contour_%d_%s, %d, %d}' % (n, kind, len(segs), loop))
+        lines.append('')
+        table.append('    {%s},' % ', '.join(entry))
+    if voices:
+        lines += ['const struct contour_voice contour_bank[] = {'] + table + \
+            ['};', 'const int contour_bank_len = %d;' % len(voices), '']
+    else:
+        # C has no empty arrays
+        lines += ['const struct contour_voice contour_bank[1] = '
+                  '{{{NULL, 0, -1}, {NULL, 0, -1}}};',
+                  'const int contour_bank_len = 0;', '']
+    return '\r\n'.join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('contours', help='the text description')
+    ap.add_argument('-o', metavar='FILE', required=True, help='the C bank')
+    args = ap.parse_args()
+
+    try:
+        with open(args.contours) as f:
+            voices = parse(f.read())
+        for n, v in enumerate(voices):
+            if not v['pitch']:
+                raise ContourError('%s has no pitch' % v['name'])
+            if not v['level']:
+                v['level'] = [(0, 1.0, 0.0)]
+            report = []
+            # level is shifted down to an _Accum below 2
+            for kind, high, limit in (('pitch', 32767, 32768), ('level', 1, 2)):
+                try:
+                    segs, loop, worst = segments(v[kind], v['loop'][kind], high, limit)
+                except ContourError as e:
+                    raise ContourError('%s %s: %s' % (v['name'], kind, e))
+                v[kind] = (segs, loop)
+                report.append('%d %s segments, within %.3g' % (len(segs), kind, worst))
+            print('%d: %s, %s' % (n, v['name'], ', '.join(report)))
+    except ContourError as e:
+        sys.exit('%s: %s' % (args.contours, e))
+    with open(args.o, 'w', newline='') as f:
+        f.write(c_source(voices, args.contours.split('/')[-1]))
+    print('%d contours' % len(voices))
+
+
+if __name__ == '__main__':
+    main()
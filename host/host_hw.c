@@ -0,0 +1,123 @@
+#include "config_1_3_2.h"
+#include "tft_master.h"
+#include "tft_gfx.h"
+
+unsigned long long host_pb_ticks;
+struct host_timer host_timer[6];
+unsigned int host_dac[2];
+unsigned int host_dac_words;
+unsigned int host_adc[2] = {512, 512};
+int host_button;
+
+// === special function registers ===
+volatile unsigned int ANSELA, ANSELB, CVRCON, OSCCON, IFS0, TMR2, PR2;
+volatile unsigned int SPI2CONSET, SPI2CONCLR, U2STA, U2RXREG, U2TXREG;
+volatile unsigned int LATBSET, LATBCLR;
+volatile __SPI2STATbits_t SPI2STATbits;
+volatile __OSCCONbits_t OSCCONbits;
+volatile __T2CONbits_t T2CONbits;
+volatile __IEC0bits_t IEC0bits;
+volatile __IFS0bits_t IFS0bits;
+
+// === timers ===
+void host_timer_open(int n, unsigned int config, unsigned int period) {
+  host_timer[n].on = (config & T2_ON) != 0;
+  host_timer[n].period = period + 1;
+  host_timer[n].next = host_pb_ticks + period + 1;
+  if (n == 2) { T2CONbits.ON = host_timer[n].on; PR2 = period; }
+}
+
+void host_timer_close(int n) {
+  host_timer[n].on = 0;
+  host_timer[n].int_on = 0;
+  if (n == 2) { T2CONbits.ON = 0; IEC0bits.T2IE = 0; }
+}
+
+void host_timer_int(int n, unsigned int config) {
+  host_timer[n].int_on = (config & T2_INT_ON) != 0;
+  if (n == 2) IEC0bits.T2IE = host_timer[n].int_on;
+}
+
+// core timer counts at half the cpu clock
+unsigned int ReadCoreTimer(void) {
+  return (unsigned int)(host_pb_ticks * (sys_clock/2) / (pb_clock));
+}
+void OpenCoreTimer(unsigned int period) {}
+void _CP0_SET_COMPARE(unsigned int compare) {}
+void mConfigIntCoreTimer(unsigned int config) {}
+
+// === ports: chip selects on PORTB, button on RB7 ===
+static unsigned int host_latb = 0xffff;
+void mPORTASetPinsDigitalIn(unsigned int bits) {}
+void mPORTBSetPinsDigitalIn(unsigned int bits) {}
+void mPORTBSetPinsDigitalOut(unsigned int bits) {}
+void mPORTBSetBits(unsigned int bits) { host_latb |= bits; }
+void mPORTBClearBits(unsigned int bits) { host_latb &= ~bits; }
+// INT from the expander idles high
+unsigned int mPORTAReadBits(unsigned int bits) { return bits; }
+unsigned int mPORTBReadBits(unsigned int bits) {
+  return host_button ? bits & ~BIT_7 : bits;
+}
+
+// === SPI2: DAC words are captured, the expander reads all ones ===
+static unsigned int host_spi_rx;
+void SpiChnOpen(int channel, unsigned int config, unsigned int div) {}
+void WriteSPI2(unsigned int data) {
+  host_spi_rx = 0xffffffff;
+  if (!(host_latb & BIT_4)) {
+    // MCP4822: bit 15 picks the channel, 12 bits of data
+    host_dac[(data >> 15) & 1] = data & 0xfff;
+    host_dac_words++;
+  }
+}
+unsigned int ReadSPI2(void) { return host_spi_rx; }
+int TxBufFullSPI2(void) { return 0; }
+
+// === ADC ===
+void CloseADC10(void) {}
+void EnableADC10(void) {}
+void SetChanADC10(unsigned int config) {}
+void OpenADC10(unsigned int p1, unsigned int p2, unsigned int p3, unsigned int p4, unsigned int p5) {}
+unsigned int ReadADC10(int buffer) { return host_adc[buffer & 1]; }
+
+// === nothing to do on the host ===
+void SYSTEMConfig(unsigned int clock, unsigned int flags) {}
+void INTEnableSystemMultiVectoredInt(void) {}
+unsigned int INTDisableInterrupts(void) { return 0; }
+void INTRestoreInterrupts(unsigned int status) {}
+void INTEnable(int source, int enable) {}
+void ConfigINT2(unsigned int config) {}
+
+void UARTConfigure(int id, unsigned int flags) {}
+void UARTSetLineControl(int id, unsigned int flags) {}
+void UARTSetDataRate(int id, unsigned int clock, unsigned int rate) {}
+void UARTEnable(int id, unsigned int flags) {}
+int UARTReceivedDataIsAvailable(int id) { return 0; }
+int UARTTransmitterIsReady(int id) { return 1; }
+unsigned char UARTGetDataByte(int id) { return 0; }
+void UARTSendDataByte(int id, unsigned char c) { putchar(c); }
+void UART2ClearAllErrors(void) {}
+
+void DmaChnOpen(int chn, int pri, int flags) {}
+void DmaChnSetMatchPattern(int chn, int pattern) {}
+void DmaChnSetTxfer(int chn, const void *src, void *dst, int src_size, int dst_size, int cell_size) {}
+void DmaChnSetEventControl(int chn, int flags) {}
+void DmaChnSetEvEnableFlags(int chn, int flags) {}
+void DmaChnEnable(int chn) {}
+void DmaChnDisable(int chn) {}
+int DmaChnGetEvFlags(int chn) { return DMA_EV_BLOCK_DONE; }
+void DmaChnClrEvFlags(int chn, int flags) {}
+void DmaChnSetIntPriority(int chn, int pri, int subpri) {}
+void DmaChnIntEnable(int chn) {}
+void DmaChnIntDisable(int chn) {}
+void DmaChnClrIntFlag(int chn) {}
+
+// the map is not drawn
+void tft_init_hw(void) {}
+void tft_begin(void) {}
+void tft_fillScreen(unsigned short color) {}
+void tft_setRotation(unsigned char m) {}
+void tft_fillRect(short x, short y, short w, short h, unsigned short color) {}
+void tft_fillCircle(short x0, short y0, short r, unsigned short color) {}
+void tft_fillTriangle(short x0, short y0, short x1, short y1,
+        short x2, short y2, unsigned short color) {}
@@ -0,0 +1,38 @@
+/*
+ * File:   host_hw.h
+ * Virtual PIC32 hardware for the host build: a peripheral bus clock,
+ * timers 2-5, the core timer, the DAC on SPI2 and the joystick
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef HOST_HW_H
+#define	HOST_HW_H
+
+// virtual time in peripheral bus clock ticks since reset; only the
+// simulator advances it
+extern unsigned long long host_pb_ticks;
+
+// a PIC32 type B timer in the only mode the firmware uses: internal
+// clock, 1:1 prescale, interrupt on period match
+struct host_timer {
+    int on, int_on;
+    unsigned int period;        // ticks between matches, PR+1
+    unsigned long long next;    // host_pb_ticks of the next match
+};
+extern struct host_timer host_timer[6];
+void host_timer_open(int n, unsigned int config, unsigned int period);
+void host_timer_close(int n);
+void host_timer_int(int n, unsigned int config);
+
+// last 12-bit value written to DAC channel A (0) and B (1), and the
+// number of DAC words written so far
+extern unsigned int host_dac[2];
+extern unsigned int host_dac_words;
+
+// joystick: ReadADC10(0) is y and ReadADC10(1) is x, 0-1023, centered at
+// 512; the button on RB7 reads low while host_button is set
+extern unsigned int host_adc[2];
+extern int host_button;
+
+#endif	/* HOST_HW_H */
@@ -0,0 +1,731 @@
+/*
+ * File:   host_sim.c
+ * Runs the audio engine of audio_map.c on a PC
+ *
+ * The firmware source is compiled unchanged, with main renamed, against
+ * the stand-in plib.h. A virtual peripheral bus clock fires the Timer2
+ * audio ISR at the period the firmware programs, and the Timer3/4/5
+ * interaural delay one-shots when they expire. The DAC words of every
+ * sample go into a stereo WAV file (DAC A = left ear). The listener
+ * walks a scripted path; at every waypoint the simulator calls
+ * spatial_update, like a press of the joystick button.
+ *
+ *   host_sim [-S scene.bin] [-o out.wav] [-p path.txt] [-s seconds]
+ *       scene.bin: a scene blob from host/scene.py instead of the one
+ *       compiled in; it also applies to -b and -g.
+ *       path.txt: one waypoint per line, "msec x y" in map pixels,
+ *       '#' starts a comment. Without -p the listener walks north up
+ *       the middle of the road, 10 pixels every 500 msec.
+ *   host_sim [-S scene.bin] [-o out.wav] -r trace.txt [-s seconds]
+ *       replays an input trace recorded on the board (host/inputs.py)
+ *       through the timer thread, one pass every 500 msec, instead of
+ *       following a path
+ *   host_sim -b samples
+ *       times the audio ISR on this machine and prints an estimate of
+ *       its cost on the PIC32; exit status 1 if scene_load's estimate
+ *       does not match it or lets the worst case through
+ *   host_sim -g
+ *       checks the spatial audio against the model of the lab notebook
+ *       over the whole map; exit status 1 if anything is out of tolerance
+ *   host_sim -c
+ *       walks the default path casting one ray a pass, as the timer
+ *       thread does, and checks that the ISR ends up playing every
+ *       source's occlusion; exit status 1 if one plays it stale
+ *
+ * Created on October 18, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define main firmware_main
+#include "../audio_map.c"
+#undef main
+
+// === scripted listener path ===
+#define MAX_WAYPOINTS 1024
+struct waypoint {
+    unsigned int msec;
+    int x, y;
+};
+static struct waypoint path[MAX_WAYPOINTS];
+static int path_len;
+
+static void default_path(void) {
+    int y;
+    path_len = 0;
+    for (y = 310; y >= 60 && path_len < MAX_WAYPOINTS; y -= 10) {
+        path[path_len].msec = path_len * 500;
+        path[path_len].x = 120;
+        path[path_len].y = y;
+        path_len++;
+    }
+}
+
+static int load_path(const char *name) {
+    char line[128];
+    FILE *f = fopen(name, "r");
+    if (f == NULL) return 0;
+    path_len = 0;
+    while (fgets(line, sizeof(line), f) && path_len < MAX_WAYPOINTS) {
+        struct waypoint *w = &path[path_len];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%u %d %d", &w->msec, &w->x, &w->y) == 3) path_len++;
+    }
+    fclose(f);
+    return path_len > 0;
+}
+
+// === recorded inputs ===
+// an input trace as host/inputs.py saves it: "start x y", "end passes",
+// then one event per line, "pass adc_x adc_y buttons"
+static int load_trace(const char *name) {
+    char line[128];
+    int a, b, c, d;
+    FILE *f = fopen(name, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot read trace %s\n", name);
+        return 0;
+    }
+    input_len = 0;
+    input_end = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "start %d %d", &a, &b) == 2) {
+            input_start_x = a;
+            input_start_y = b;
+        } else if (sscanf(line, "end %d", &a) == 1) {
+            input_end = a;
+        } else if (sscanf(line, "%d %d %d %d", &a, &b, &c, &d) == 4 && input_len < INPUT_EVENTS) {
+            input_trace[input_len].pass = a;
+            input_trace[input_len].adc_x = b;
+            input_trace[input_len].adc_y = c;
+            input_trace[input_len].buttons = d;
+            input_len++;
+        }
+    }
+    fclose(f);
+    if (input_len == 0 || input_trace[0].pass != 0 || input_end <= input_trace[input_len-1].pass) {
+        fprintf(stderr, "%s: not a trace\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+// a scene blob in place of scene_default, as an upload would
+static int load_scene(const char *name) {
+    static unsigned char blob[SCENE_BLOB_MAX];
+    int len, result;
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot read scene %s\n", name);
+        return 0;
+    }
+    len = fread(blob, 1, sizeof(blob), f);
+    fclose(f);
+    result = scene_load(&scene, blob, len);
+    if (result != SCENE_OK) {
+        fprintf(stderr, "%s: scene_load error %d\n", name, result);
+        return 0;
+    }
+    xpos = int2Accum(scene.start_x);
+    ypos = int2Accum(scene.start_y);
+    spatial_grid_init();
+    occlusion_reset();
+    motion_reset();
+    return 1;
+}
+
+// === stereo output ===
+static short *wav_buf;
+static unsigned int wav_len, wav_size;
+
+static void wav_frame(void) {
+    int ch;
+    if (wav_len + 2 > wav_size) {
+        wav_size = wav_size ? 2*wav_size : 1 << 20;
+        wav_buf = realloc(wav_buf, wav_size * sizeof(short));
+        if (wav_buf == NULL) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+    // 12-bit DAC code around mid scale to 16-bit signed
+    for (ch = 0; ch < 2; ch++) wav_buf[wav_len++] = (short)(((int)host_dac[ch] - 2048) << 4);
+}
+
+static void put16(FILE *f, unsigned int v) { fputc(v & 0xff, f); fputc((v >> 8) & 0xff, f); }
+static void put32(FILE *f, unsigned int v) { put16(f, v & 0xffff); put16(f, v >> 16); }
+
+static int wav_write(const char *name, unsigned int rate) {
+    unsigned int i, bytes = wav_len * 2;
+    FILE *f = fopen(name, "wb");
+    if (f == NULL) return 0;
+    fwrite("RIFF", 1, 4, f); put32(f, 36 + bytes);
+    fwrite("WAVEfmt ", 1, 8, f); put32(f, 16);
+    put16(f, 1); put16(f, 2);               // PCM, stereo
+    put32(f, rate); put32(f, rate * 4);     // sample rate, byte rate
+    put16(f, 4); put16(f, 16);              // frame size, bits
+    fwrite("data", 1, 4, f); put32(f, bytes);
+    for (i = 0; i < wav_len; i++) put16(f, (unsigned short)wav_buf[i]);
+    fclose(f);
+    return 1;
+}
+
+// === virtual clock ===
+static void (*const sim_isr[6])(void) = {
+    NULL, NULL, Timer2Handler, Timer3Handler, Timer4Handler, Timer5Handler
+};
+
+// run every timer interrupt due up to pb tick t_end, in time order; on
+// a tie Timer2 goes first, it has the higher priority. frame, if not
+// NULL, is called after every audio sample
+static void sim_run_isrs(unsigned long long t_end, void (*frame)(void)) {
+    int n, due;
+    while (1) {
+        due = 0;
+        for (n = 2; n <= 5; n++) {
+            struct host_timer *t = &host_timer[n];
+            if (t->on && t->int_on && t->next <= t_end &&
+                (due == 0 || t->next < host_timer[due].next)) due = n;
+        }
+        if (due == 0) break;
+        host_pb_ticks = host_timer[due].next;
+        host_timer[due].next += host_timer[due].period;
+        sim_isr[due]();
+        if (due == 2 && frame != NULL) frame();
+    }
+    host_pb_ticks = t_end;
+}
+
+#define MSEC_TICKS ((unsigned long long)(pb_clock)/1000)
+
+// the interrupts up to t_end, and the motion thread every MOTION_MSEC
+static unsigned long long motion_next = MOTION_MSEC*MSEC_TICKS;
+static void sim_run(unsigned long long t_end, void (*frame)(void)) {
+    while (motion_next <= t_end) {
+        sim_run_isrs(motion_next, frame);
+        motion_step();
+        motion_next += MOTION_MSEC*MSEC_TICKS;
+    }
+    sim_run_isrs(t_end, frame);
+}
+
+// move the listener and recompute, as the joystick thread would; the
+// rays it would cast over the next passes are all cast at once
+static void sim_listener(int x, int y) {
+    int s;
+    xpos = int2Accum(x);
+    ypos = int2Accum(y);
+    for (s = 0; s < scene.sources; s++) occlusion_step();
+    spatial_update();
+}
+
+// === PIC32 cost estimate ===
+// Operations in one Timer2Handler call, counted by hand from the source,
+// with rough cycle costs for the M4K core. It has no FPU, so float and
+// double math are library calls. Keep the counts in step with the ISR.
+// A row with a voice is for one source playing it, both ears; chirp
+// stands for the DDS voices, the dearest of them. The rest are for the
+// whole ISR. The scene's estimate counts the voices it plays, the worst
+// case every source playing the dearest voice. The totals are what
+// scene_load holds scenes to: SCENE_ISR_SHARED and scene_voice_cycles
+// must match them, and the worst case must be refused.
+static const struct {
+    const char *what;
+    int voice, count, cycles;
+} isr_ops[] = {
+    {"float mul/add (chirp Fout)",        VOICE_CHIRP,  2*3,  60},
+    {"int to float (chirp Fout)",         VOICE_CHIRP,  2*1,  40},
+    {"float mul (DDS increment)",         VOICE_CHIRP,  2*1,  60},
+    {"float to unsigned (DDS increment)", VOICE_CHIRP,  2*1,  40},
+    {"ADPCM nibble, step table, clamps",  VOICE_SAMPLE, 2*30,  1},
+    {"block header, 1 in 64",             VOICE_SAMPLE, 2*1,   4},
+    {"_Accum mul (sample level)",         VOICE_SAMPLE, 2*1,   6},
+    {"int mul (noise SVF)",               VOICE_NOISE,  2*3,   2},
+    {"LFSR and SVF shifts, adds, xors",   VOICE_NOISE,  2*12,  1},
+    {"DDS and table lookup (FM modulator)", VOICE_FM,   2*1,   8},
+    {"_Accum mul (FM index)",             VOICE_FM,     2*1,   6},
+    {"contour step, segment load worst",  VOICE_CONTOUR, 2*2, 20},
+    {"64 bit multiply, shift (pitch)",    VOICE_CONTOUR, 2*1, 10},
+    {"_Accum mul (level, sine)",          VOICE_CONTOUR, 2*2,  6},
+    {"_Accum mul (DAC sums)",             VOICE_NONE,   6,     6},
+    {"_Accum mul (head shadow)",          VOICE_NONE,   3,     6},
+    {"_Accum mul (air absorption)",       VOICE_NONE,   6,     6},
+    {"_Accum mul (early reflections)",    VOICE_NONE,   3*(1 + 2*REFL_TAPS), 6},
+    {"delay line index and load",         VOICE_NONE,   3*2*REFL_TAPS, 3},
+    {"_Accum mul (reverb send)",          VOICE_NONE,   3,     6},
+    {"reverb call and interpolation",     VOICE_NONE,   1,    30},
+    {"reverb combs and allpasses, 1 in 4", VOICE_NONE,  1,    40},
+    {"SPI word at pb_clock/4, waited on", VOICE_NONE,   2,    64},
+    {"expander transaction, worst case",  VOICE_NONE,   1, SPI2_XFER_CYCLES},
+    {"loads, stores, compares, branches", VOICE_NONE,   250,   1},
+};
+static const char *voice_name[VOICES] = {
+    "none", "chirp", "ramp", "tones", "sample", "noise", "fm", "contour"
+};
+
+static int bench(unsigned int samples) {
+    static struct scene worst;
+    static unsigned char blob[SCENE_BLOB_MAX];
+    struct timespec t0, t1;
+    unsigned int i, cycles, budget, voice_cycles[VOICES], crc;
+    int s, v, dearest = VOICE_CHIRP, failed = 0, result;
+    double ns;
+    sim_listener(120, 310);
+    // let the far ears start so every source is playing
+    sim_run(host_pb_ticks + 10*MSEC_TICKS, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < samples; i++) Timer2Handler();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = (t1.tv_sec - t0.tv_sec)*1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("host: %.1f ns per sample (%u samples)\n", ns/samples, samples);
+
+    // cpu cycles between two Timer2 interrupts
+    budget = SAMPLE_PERIOD * (sys_clock/(pb_clock));
+    printf("PIC32 estimate per sample:\n");
+    for (v = 0; v < VOICES; v++) {
+        voice_cycles[v] = 0;
+        for (i = 0; i < sizeof(isr_ops)/sizeof(isr_ops[0]); i++) {
+            if (isr_ops[i].voice != v) continue;
+            if (voice_cycles[v] == 0)
+                printf(v == VOICE_NONE ? "  every sample\n" : "  each source playing %s\n", voice_name[v]);
+            printf("    %-36s %4d x %3d = %5d\n", isr_ops[i].what,
+                isr_ops[i].count, isr_ops[i].cycles, isr_ops[i].count*isr_ops[i].cycles);
+            voice_cycles[v] += isr_ops[i].count*isr_ops[i].cycles;
+        }
+        if (v != VOICE_NONE && voice_cycles[v] > voice_cycles[dearest]) dearest = v;
+    }
+    // the other DDS voices cost what the chirp does
+    voice_cycles[VOICE_RAMP] = voice_cycles[VOICE_TONES] = voice_cycles[VOICE_CHIRP];
+    cycles = voice_cycles[VOICE_NONE];
+    for (s = 0; s < scene.sources; s++) cycles += voice_cycles[scene.src[s].voice.type];
+    printf("  scene total %u cycles of %u (%u%%)\n", cycles, budget, cycles*100/budget);
+    cycles = voice_cycles[VOICE_NONE] + NUM_SOURCES*voice_cycles[dearest];
+    printf("  worst case, every source %s: %u cycles of %u (%u%%)\n",
+        voice_name[dearest], cycles, budget, cycles*100/budget);
+
+    // scene_load's estimate
+    if (budget != SCENE_ISR_BUDGET || voice_cycles[VOICE_NONE] != SCENE_ISR_SHARED) {
+        printf("scene.h: budget %d, every sample %d, not %u and %u\n",
+            SCENE_ISR_BUDGET, SCENE_ISR_SHARED, budget, voice_cycles[VOICE_NONE]);
+        failed++;
+    }
+    for (v = VOICE_NONE + 1; v < VOICES; v++)
+        if (scene_voice_cycles[v] != voice_cycles[v]) {
+            printf("scene_voice_cycles: %s %d, not %u\n", voice_name[v],
+                scene_voice_cycles[v], voice_cycles[v]);
+            failed++;
+        }
+    // the default scene with every source on the dearest voice
+    memcpy(blob, scene_default, scene_default_len);
+    for (s = 0; s < blob[5]; s++)
+        blob[SCENE_HEADER + SCENE_LISTENER + blob[6]*SCENE_BLOCKED + s*SCENE_SOURCE] = dearest;
+    crc = frame_crc16(blob + SCENE_HEADER, scene_default_len - SCENE_HEADER);
+    blob[10] = crc & 0xff;
+    blob[11] = crc >> 8;
+    result = scene_load(&worst, blob, scene_default_len);
+    printf("  scene_load of the worst case: %d, scene %d\n", result, scene_isr_cycles(&scene));
+    if (result != SCENE_BAD_COST || scene_isr_cycles(&scene) > SCENE_ISR_BUDGET) failed++;
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
+
+// === golden model check ===
+// calc() of Lab1_audio_synthesis.ipynb: a source at degree off the
+// listener's forward axis reaches the far ear delay seconds late,
+// with intensity times the amplitude; data_points is the delay in
+// samples at the given frequency
+static void golden_calc(double degree, double radius, double speed_sound,
+        double frequency, double *delay, double *intensity, double *data_points) {
+    double rad = degree * M_PI / 180;
+    *intensity = cos(rad);
+    *delay = radius/speed_sound*(rad + sin(rad));
+    *data_points = *delay/(1/frequency);
+}
+
+// Every listener position the joystick can reach, every 10 pixels, and
+// every source is checked twice:
+//  - the parameters spatial_update computes: far ear side, ITD timer
+//    period within half a sample, far/near gain within 1%;
+//  - on every third row, the output: the source is rendered alone and
+//    each ear's envelope is recovered from the DAC words. The far ear
+//    must start data_points +-1.5 samples after the near ear (the ISR
+//    starts notes on sample boundaries) at intensity +-2% of its level.
+//    The DDS voices, whose phase runs on from note to note, give the
+//    envelope by dividing the DAC words by the carrier, and the start
+//    of each ear's attack ramp by a line fit. The other voices start
+//    their waveform over with each note, so the far ear plays the near
+//    ear's DAC words later and quieter: the lag and gain are where the
+//    two ears cross-correlate best.
+#define GOLD_GAIN_TOL 0.01
+#define GOLD_RENDER_ITD_TOL 1.5
+#define GOLD_RENDER_GAIN_TOL 0.02
+#define GOLD_X0 90
+#define GOLD_X1 150
+#define GOLD_Y0 10
+#define GOLD_Y1 310
+#define GOLD_STEP 10
+#define GOLD_RENDER_EVERY 3
+#define GOLD_RENDER_MAX 8192
+// the rendered source is scaled to this near ear peak, in DAC codes: at
+// the few codes of the map levels truncation swamps the envelope
+#define GOLD_RENDER_PEAK 1500.0
+// samples after the attacks that give the tops of the ramps
+#define GOLD_TOP 256
+// the car has no sustain to measure against, and only the DDS voices
+// are a carrier to divide the DAC words by; a contour's level is the
+// same in both ears, and divides out of the far/near ratio
+#define GOLD_DDS_VOICE(t) ((t) == VOICE_CHIRP || (t) == VOICE_RAMP || (t) == VOICE_TONES || \
+    (t) == VOICE_CONTOUR)
+#define GOLD_RENDERED(s) ((s) != CAR && GOLD_DDS_VOICE(scene.src[s].voice.type))
+// the voices that start their waveform over with each note, and the
+// lags tried for them either side of 0 to 2*data_points
+#define GOLD_RESTARTS(t) ((t) == VOICE_SAMPLE || (t) == VOICE_NOISE || (t) == VOICE_FM)
+#define GOLD_XCORR_SLACK 4
+// and the near ear RMS, in DAC codes, a voice must have to be checked
+#define GOLD_XCORR_QUIET 20
+
+struct gold_stat {
+    const char *what;
+    double max_err;
+    int checked, failed;
+};
+
+static void gold_check(struct gold_stat *st, double err, double tol) {
+    if (err < 0) err = -err;
+    if (err > st->max_err) st->max_err = err;
+    st->checked++;
+    if (err > tol) st->failed++;
+}
+
+static void gold_print(const struct gold_stat *st, const char *unit) {
+    printf("  %-12s %5d checked, max error %8.4f %-8s %s\n", st->what, st->checked,
+        st->max_err, unit, st->failed ? "FAIL" : "ok");
+}
+
+// both ears of the rendered source: centered DAC code and carrier
+static int gold_src, gold_frames;
+static int gold_dac[2][GOLD_RENDER_MAX];
+static double gold_carrier[2][GOLD_RENDER_MAX];
+
+static void gold_frame(void) {
+    int ear;
+    if (gold_frames >= GOLD_RENDER_MAX) return;
+    for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++) {
+        gold_dac[ear][gold_frames] = (int)host_dac[ear] - 2048;
+        gold_carrier[ear][gold_frames] = sine_table[DDS_phase[gold_src][ear] >> 24];
+    }
+    gold_frames++;
+}
+
+// normalized cross-correlation of the far ear's DAC words lag samples
+// after the near ear's, and the far/near gain at that lag
+static double gold_xcorr(int near, int far, int frames, int lag, double *gain) {
+    double nf = 0, nn = 0, ff = 0;
+    int i;
+    for (i = (lag < 0)? -lag : 0; i < frames && i + lag < frames; i++) {
+        nf += (double)gold_dac[near][i]*gold_dac[far][i + lag];
+        nn += (double)gold_dac[near][i]*gold_dac[near][i];
+        ff += (double)gold_dac[far][i + lag]*gold_dac[far][i + lag];
+    }
+    if (gain != NULL) *gain = nf/nn;
+    return nf/sqrt(nn*ff);
+}
+
+// the RMS of one ear's DAC words
+static double gold_rms(int ear, int frames) {
+    double sum = 0;
+    int i;
+    for (i = 0; i < frames; i++) sum += (double)gold_dac[ear][i]*gold_dac[ear][i];
+    return sqrt(sum/frames);
+}
+
+// how many samples after the near ear the far ear starts, the best lag
+// refined by a parabola through its neighbours
+static double gold_lag(int near, int far, int frames, double data_points, double *gain) {
+    double r, r_best = -2, r_lo, r_hi, d;
+    int k, best = 0;
+    for (k = -GOLD_XCORR_SLACK; k <= 2*data_points + GOLD_XCORR_SLACK; k++) {
+        r = gold_xcorr(near, far, frames, k, NULL);
+        if (r > r_best) {
+            r_best = r;
+            best = k;
+        }
+    }
+    r_lo = gold_xcorr(near, far, frames, best - 1, NULL);
+    r_hi = gold_xcorr(near, far, frames, best + 1, NULL);
+    gold_xcorr(near, far, frames, best, gain);
+    d = r_lo - 2*r_best + r_hi;
+    return best + ((d < 0)? (r_lo - r_hi)/(2*d) : 0);
+}
+
+// all voices silent and idle, no delay timer pending
+static void gold_reset(void) {
+    unsigned int ev;
+    memset((void *)env, 0, sizeof(env));
+    memset((void *)DDS_phase, 0, sizeof(DDS_phase));
+    while (spsc_get(&near_queue, &ev));
+    while (spsc_get(&far_queue, &ev));
+    while (spsc_get(&started_queue, &ev));
+    host_timer_close(3);
+    host_timer_close(4);
+    host_timer_close(5);
+}
+
+// envelope of one ear: the DAC words divided by the carrier wherever it
+// is large enough. Over [i0, i1) either the mean (slope == NULL) or a
+// straight line fit; returns the level, or where the line crosses zero
+static double gold_envelope(int ear, int i0, int i1, double lo, double hi, double *slope) {
+    double n = 0, st = 0, sa = 0, stt = 0, sta = 0, a, k;
+    int i;
+    for (i = i0; i < i1; i++) {
+        if (fabs(gold_carrier[ear][i]) < 0.5) continue;
+        // the ISR truncates toward zero, half a code on average
+        a = (gold_dac[ear][i] + (gold_carrier[ear][i] > 0 ? 0.5 : -0.5)) / gold_carrier[ear][i];
+        if (a < lo || a > hi) continue;
+        n++; st += i; sa += a; stt += (double)i*i; sta += i*a;
+    }
+    if (n < 2) return 0;
+    if (slope == NULL) return sa/n;
+    k = (n*sta - st*sa)/(n*stt - st*st);
+    *slope = k;
+    return (st - sa/k)/n;
+}
+
+static int golden(void) {
+    struct gold_stat side = {"far ear"}, itd = {"itd"}, gain = {"gain"};
+    struct gold_stat ritd = {"render itd"}, rgain = {"render gain"};
+    struct gold_stat xitd = {"xcorr itd"}, xgain = {"xcorr gain"};
+    double rate, delay, intensity, data_points, tick_tol, scale, slope;
+    double near_level, far_level, near_top, far_top, near_start, far_start, lag, ratio;
+    int x, y, s, n, ear, row, dx, dy, near, far, length, top;
+    struct source_params *p, *q;
+
+    // the model has no head shadow, no air, no buildings and no street
+    head_shadow_on = 0;
+    air_absorption_on = 0;
+    occlusion_on = 0;
+    reflections_on = 0;
+    reverb_on = 0;
+    rate = (double)(pb_clock)/(SAMPLE_PERIOD + 1);
+    tick_tol = (double)(pb_clock)/rate/2;
+    for (y = GOLD_Y0, row = 0; y <= GOLD_Y1; y += GOLD_STEP, row++) {
+        for (x = GOLD_X0; x <= GOLD_X1; x += GOLD_STEP) {
+            for (s = 0; s < scene.sources; s++) {
+                dx = scene.src[s].x - x;
+                dy = scene.src[s].y - y;
+                if (dx == 0 && dy == 0) continue;
+                // the model, from the map geometry alone
+                golden_calc(atan2(abs(dx), abs(dy)) * 180 / M_PI, head_radius, sound_speed,
+                    rate, &delay, &intensity, &data_points);
+
+                gold_reset();
+                sim_listener(x, y);
+                p = &DBUF_FRONT(spatial)->src[s];
+                near = !p->far_ear;
+                far = p->far_ear;
+                // a source on the right is heard late in the left ear
+                gold_check(&side, (dx > 0 ? LEFT_EAR : RIGHT_EAR) != far, 0);
+                gold_check(&itd, (source_itd[s] + 1) - delay*(pb_clock), tick_tol);
+                // out of earshot both slopes are zero
+                if (p->attack_inc[near] <= 0) continue;
+                gold_check(&gain, (double)p->attack_inc[far]/(double)p->attack_inc[near] - intensity,
+                    GOLD_GAIN_TOL);
+
+                if (row % GOLD_RENDER_EVERY != 0) continue;
+                if (!GOLD_RENDERED(s) && !GOLD_RESTARTS(scene.src[s].voice.type)) continue;
+                // this source alone, loud enough to measure
+                scale = GOLD_RENDER_PEAK/((double)p->attack_inc[near]*scene.src[s].attack);
+                for (n = 0; n < NUM_SOURCES; n++) {
+                    q = &DBUF_FRONT(spatial)->src[n];
+                    for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++) {
+                        q->attack_inc[ear] = (n == s)? q->attack_inc[ear]*scale : 0;
+                        q->decay_inc[ear] = (n == s)? q->decay_inc[ear]*scale : 0;
+                    }
+                }
+                // attack and sustain of both ears
+                length = scene.src[s].attack + scene.src[s].sustain;
+                if (length > GOLD_RENDER_MAX) length = GOLD_RENDER_MAX;
+                gold_src = s;
+                gold_frames = 0;
+                sim_run(host_pb_ticks + (unsigned long long)length*(SAMPLE_PERIOD + 1), gold_frame);
+
+                if (!GOLD_RENDERED(s)) {
+                    // a voice or an ear a few codes loud is mostly truncation
+                    if (gold_rms(near, length) < GOLD_XCORR_QUIET) continue;
+                    lag = gold_lag(near, far, length, data_points, &ratio);
+                    if (ratio < 0.05) continue;
+                    gold_check(&xitd, lag - data_points, GOLD_RENDER_ITD_TOL);
+                    gold_check(&xgain, ratio - intensity, GOLD_RENDER_GAIN_TOL);
+                    continue;
+                }
+                // levels from the second half, both ears are sustaining
+                near_level = gold_envelope(near, length/2, length, -1e9, 1e9, NULL);
+                far_level = gold_envelope(far, length/2, length, -1e9, 1e9, NULL);
+                // an ear a few codes loud has no measurable ramp
+                if (far_level < 0.05*near_level) continue;
+                // the tops of the ramps, just after both attacks: a
+                // contour's level moves on over the sustain
+                top = scene.src[s].attack + 2*data_points + 4;
+                near_top = near_level;
+                far_top = far_level;
+                if (top + GOLD_TOP < length) {
+                    near_top = gold_envelope(near, top, top + GOLD_TOP, -1e9, 1e9, NULL);
+                    far_top = gold_envelope(far, top, top + GOLD_TOP, -1e9, 1e9, NULL);
+                }
+                // where each attack ramp starts, from its middle 80%
+                near_start = gold_envelope(near, 0, top, 0.1*near_top, 0.9*near_top, &slope);
+                far_start = gold_envelope(far, 0, top, 0.1*far_top, 0.9*far_top, &slope);
+                gold_check(&ritd, (far_start - near_start) - data_points, GOLD_RENDER_ITD_TOL);
+                gold_check(&rgain, far_level/near_level - intensity, GOLD_RENDER_GAIN_TOL);
+            }
+        }
+    }
+    printf("golden: sample rate %.0f Hz, head radius %d, speed of sound %d\n",
+        rate, head_radius, sound_speed);
+    gold_print(&side, "");
+    gold_print(&itd, "ticks");
+    gold_print(&gain, "");
+    gold_print(&ritd, "samples");
+    gold_print(&rgain, "");
+    gold_print(&xitd, "samples");
+    gold_print(&xgain, "");
+    n = side.failed + itd.failed + gain.failed + ritd.failed + rgain.failed +
+        xitd.failed + xgain.failed;
+    printf("%s\n", n ? "FAIL" : "PASS");
+    return n ? 1 : 0;
+}
+
+// === occlusion check ===
+// The timer thread casts one ray a pass, so most of the rays at a new
+// listener position land after the press. Walk the default path the
+// way it does, a press at every waypoint and a pass every 500 msec, and
+// once every ray is cast and every note has looped, check that the
+// slopes and air the ISR plays are those of all the rays cast at once.
+static int occlusion_check(void) {
+    struct source_params ref, *p;
+    unsigned int length;
+    int w, s, ear, d, pass, bad, checked = 0, occluded = 0, failed = 0;
+
+    default_path();
+    for (w = 0; w < path_len; w++) {
+        xpos = int2Accum(path[w].x);
+        ypos = int2Accum(path[w].y);
+        spatial_update();
+        for (pass = 0; pass < scene.sources; pass++) {
+            occlusion_publish();
+            sim_run(host_pb_ticks + 500*MSEC_TICKS, NULL);
+        }
+        // the static notes all loop once more
+        for (s = 0, length = 0; s < scene.sources; s++)
+            if (DBUF_FRONT(spatial)->src[s].note_length > length)
+                length = DBUF_FRONT(spatial)->src[s].note_length;
+        sim_run(host_pb_ticks + (length + 2ULL)*(SAMPLE_PERIOD + 1), NULL);
+        for (s = 0; s < scene.sources; s++) {
+            if (scene.src[s].speed > 0) continue;
+            d = scene_ray(&scene, path[w].x, path[w].y, scene.src[s].x, scene.src[s].y);
+            occ_depth[s] = (d < OCC_DEPTHS)? d : OCC_DEPTHS - 1;
+            memset(&ref, 0, sizeof(ref));
+            source_update(&ref, s, path[w].x, path[w].y);
+            p = &DBUF_FRONT(spatial)->src[s];
+            bad = p->air != ref.air;
+            for (ear = LEFT_EAR; ear <= RIGHT_EAR; ear++)
+                bad |= p->attack_inc[ear] != ref.attack_inc[ear] ||
+                    p->decay_inc[ear] != ref.decay_inc[ear] ||
+                    env[s][ear].attack_inc != ref.attack_inc[ear] ||
+                    env[s][ear].decay_inc != ref.decay_inc[ear];
+            if (bad) printf("  %d %d: source %d plays %d cells of occlusion stale\n",
+                path[w].x, path[w].y, s, occ_depth[s]);
+            checked++;
+            occluded += occ_depth[s] > 0;
+            failed += bad;
+        }
+    }
+    printf("occlusion: %d sources checked over %d waypoints, %d occluded, %d stale\n",
+        checked, path_len, occluded, failed);
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
+
+// the WAV plays at the Timer2 rate the firmware programmed
+static int wav_finish(const char *out, unsigned int *rate) {
+    *rate = (unsigned int)((pb_clock)/host_timer[2].period);
+    if (*rate != (unsigned int)Fs)
+        printf("note: Timer2 runs at %u Hz, the DDS assumes Fs = %u Hz\n", *rate, (unsigned int)Fs);
+    if (!wav_write(out, *rate)) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 0;
+    }
+    return 1;
+}
+
+// the timer thread runs every 500 msec on the recorded inputs, from
+// the first pass of the trace at time 0
+static int replay(const char *trace_file, const char *out, unsigned int seconds) {
+    unsigned long long t_end;
+    unsigned int pass, rate;
+    if (!load_trace(trace_file)) return 1;
+    input_replay();
+    if (input_mode != INPUT_REPLAY) {
+        fprintf(stderr, "%s: the scene does not let the listener start at %d %d\n",
+            trace_file, input_start_x, input_start_y);
+        return 1;
+    }
+    // play on for two seconds after the last pass
+    t_end = seconds ? seconds*1000ULL*MSEC_TICKS : (input_end*500ULL + 2000)*MSEC_TICKS;
+    for (pass = 0; pass < input_end; pass++) {
+        sim_run(pass*500ULL*MSEC_TICKS, wav_frame);
+        timer_pass();
+    }
+    sim_run(t_end, wav_frame);
+    if (!wav_finish(out, &rate)) return 1;
+    printf("%s: %u samples at %u Hz, %d events over %u passes, listener ends at %d %d\n",
+        out, wav_len/2, rate, input_len, input_end, Accum2int(xpos), Accum2int(ypos));
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out = "audio_map.wav", *path_file = NULL, *trace_file = NULL;
+    unsigned int bench_samples = 0, seconds = 0, rate;
+    const char *scene_file = NULL;
+    int golden_check = 0, occlusion_test = 0;
+    unsigned long long t_end;
+    int i, w;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i+1 < argc) out = argv[++i];
+        else if (!strcmp(argv[i], "-p") && i+1 < argc) path_file = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i+1 < argc) seconds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i+1 < argc) bench_samples = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-g")) golden_check = 1;
+        else if (!strcmp(argv[i], "-c")) occlusion_test = 1;
+        else if (!strcmp(argv[i], "-S") && i+1 < argc) scene_file = argv[++i];
+        else if (!strcmp(argv[i], "-r") && i+1 < argc) trace_file = argv[++i];
+        else {
+            fprintf(stderr, "usage: %s [-S scene.bin] [-o out.wav] [-p path.txt | -r trace.txt] [-s seconds] | -b samples | -g | -c\n", argv[0]);
+            return 2;
+        }
+    }
+
+    audio_init();
+    if (scene_file != NULL && !load_scene(scene_file)) return 1;
+    if (golden_check) return golden();
+    if (occlusion_test) return occlusion_check();
+    if (bench_samples) return bench(bench_samples);
+
+    if (trace_file != NULL) return replay(trace_file, out, seconds);
+    if (path_file == NULL) default_path();
+    else if (!load_path(path_file)) {
+        fprintf(stderr, "cannot read path %s\n", path_file);
+        return 1;
+    }
+    // play on for two seconds after the last waypoint
+    t_end = seconds ? seconds*1000ULL*MSEC_TICKS : (path[path_len-1].msec + 2000)*MSEC_TICKS;
+    for (w = 0; w < path_len; w++) {
+        sim_run(path[w].msec*MSEC_TICKS, wav_frame);
+        sim_listener(path[w].x, path[w].y);
+    }
+    sim_run(t_end, wav_frame);
+
+    if (!wav_finish(out, &rate)) return 1;
+    printf("%s: %u samples at %u Hz, %d waypoints\n", out, wav_len/2, rate, path_len);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Save and upload the input traces of audio_map.c.
+
+The firmware records the joystick and buttons after "i r" is typed on
+its serial port, until "i s"; "i p" plays the trace back in place of
+the joystick. The FRAME_INPUT payload is described in the input
+record / replay section of audio_map.c.
+
+    python3 inputs.py /dev/ttyUSB0 --save walk.trace     dump the trace
+    python3 inputs.py /dev/ttyUSB0 --upload walk.trace   send one back
+    python3 inputs.py /dev/ttyUSB0 --upload walk.trace --play
+
+host_sim -r walk.trace replays a saved trace in the host build. Needs
+pyserial.
+"""
+import argparse
+import struct
+import sys
+import time
+
+from telemetry import FrameReader
+from tune import send, status_text
+
+FRAME_INPUT = 0x05
+HEADER = struct.Struct('<HHHBB')
+EVENT = struct.Struct('<HHHB')
+# events per upload frame, as INPUT_FRAME_EVENTS
+FRAME_EVENTS = 7
+EVENTS_MAX = 128
+
+
+def save(trace, name):
+    (x, y), end, events = trace
+    with open(name, 'w') as f:
+        f.write('# input trace of audio_map.c, replay with host_sim -r\n')
+        f.write('start %d %d\n' % (x, y))
+        f.write('end %d\n' % end)
+        f.write('# pass adc_x adc_y buttons\n')
+        for e in events:
+            f.write('%d %d %d %d\n' % e)
+
+
+def load(name):
+    start, end, events = None, None, []
+    with open(name) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split('#')[0].split()
+            if not words:
+                continue
+            try:
+                if words[0] == 'start':
+                    start = (int(words[1]), int(words[2]))
+                elif words[0] == 'end':
+                    end = int(words[1])
+                else:
+                    events.append(tuple(int(w) for w in words[:4]))
+            except (ValueError, IndexError):
+                sys.exit('%s line %d: %s' % (name, number, line.strip()))
+    if start is None or end is None or not events:
+        sys.exit('%s: needs start, end and at least one event' % name)
+    if events[0][0] != 0 or end <= events[-1][0] or len(events) > EVENTS_MAX:
+        sys.exit('%s: events from pass 0, before end, at most %d'
+                 % (name, EVENTS_MAX))
+    return start, end, events
+
+
+def dump(port):
+    """The trace in the firmware, or None if it did not answer."""
+    reader = FrameReader()
+    port.write(b'i d\r')
+    events, total = {}, None
+    deadline = time.time() + 2.0
+    while time.time() < deadline:
+        for ftype, _, payload in reader.feed(port.read(256)):
+            if ftype != FRAME_INPUT:
+                continue
+            x, y, end, first, total = HEADER.unpack_from(payload)
+            for i in range(0, len(payload) - HEADER.size, EVENT.size):
+                events[first + i // EVENT.size] = \
+                    EVENT.unpack_from(payload, HEADER.size + i)
+            if len(events) >= total:
+                return (x, y), end, [events[i] for i in range(total)]
+    return None
+
+
+def upload(port, trace):
+    (x, y), end, events = trace
+    reader = FrameReader()
+    seq = int(time.time())
+    for first in range(0, len(events), FRAME_EVENTS):
+        chunk = events[first:first + FRAME_EVENTS]
+        payload = HEADER.pack(x, y, end, first, len(events)) + \
+            b''.join(EVENT.pack(*e) for e in chunk)
+        ack = send(port, reader, FRAME_INPUT, seq, payload)
+        seq += 1
+        if ack is None:
+            sys.exit('no answer at event %d' % first)
+        status, bad = ack
+        if status != 0:
+            sys.exit('refused at event %d: %s' % (bad, status_text(status)))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port')
+    ap.add_argument('--save', metavar='FILE', help='dump the trace to FILE')
+    ap.add_argument('--upload', metavar='FILE', help='send the trace in FILE')
+    ap.add_argument('--play', action='store_true', help='then replay it')
+    ap.add_argument('--baud', type=int, default=115200)
+    args = ap.parse_args()
+
+    import serial
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    if args.save:
+        trace = dump(port)
+        if trace is None:
+            sys.exit('no answer')
+        if not trace[2]:
+            sys.exit('nothing recorded')
+        save(trace, args.save)
+        print('%d events over %d passes' % (len(trace[2]), trace[1]))
+    if args.upload:
+        upload(port, load(args.upload))
+    if args.play:
+        port.write(b'i p\r')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,226 @@
+/*
+ * File:   plib.h (host build)
+ * Stand-in for the Microchip peripheral library so that the firmware
+ * compiles on a PC. Only what the audio code, the scheduler and the
+ * SPI2 drivers use is here. Timers, the core timer, the DAC on SPI2 and
+ * the joystick are modeled in host_hw.c; the rest does nothing.
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef HOST_PLIB_H
+#define	HOST_PLIB_H
+#include <string.h>
+#include <stdio.h>
+#include "host_hw.h"
+
+// interrupt handlers are plain functions, called by the simulator
+#define __ISR(vector, ipl)
+#define _TIMER_2_VECTOR 8
+#define _TIMER_3_VECTOR 12
+#define _TIMER_4_VECTOR 16
+#define _TIMER_5_VECTOR 20
+#define _CORE_TIMER_VECTOR 0
+#define _EXTERNAL_2_VECTOR 11
+#define _DMA_0_VECTOR 36
+#define _DMA_1_VECTOR 37
+
+#define BIT_0  (1 << 0)
+#define BIT_1  (1 << 1)
+#define BIT_2  (1 << 2)
+#define BIT_3  (1 << 3)
+#define BIT_4  (1 << 4)
+#define BIT_5  (1 << 5)
+#define BIT_7  (1 << 7)
+#define BIT_9  (1 << 9)
+
+// === special function registers ===
+extern volatile unsigned int ANSELA, ANSELB, CVRCON, OSCCON, IFS0, TMR2, PR2;
+extern volatile unsigned int SPI2CONSET, SPI2CONCLR, U2STA, U2RXREG, U2TXREG;
+extern volatile unsigned int LATBSET, LATBCLR;
+typedef struct { unsigned SPIBUSY:1; unsigned SPIRBF:1; } __SPI2STATbits_t;
+typedef struct { unsigned PBDIV:2; } __OSCCONbits_t;
+typedef struct { unsigned ON:1; } __T2CONbits_t;
+typedef struct { unsigned T2IE:1; unsigned INT2IE:1; } __IEC0bits_t;
+typedef struct { unsigned T2IF:1; } __IFS0bits_t;
+extern volatile __SPI2STATbits_t SPI2STATbits;
+extern volatile __OSCCONbits_t OSCCONbits;
+extern volatile __T2CONbits_t T2CONbits;
+extern volatile __IEC0bits_t IEC0bits;
+extern volatile __IFS0bits_t IFS0bits;
+
+// === ports ===
+void mPORTASetPinsDigitalIn(unsigned int);
+void mPORTBSetPinsDigitalIn(unsigned int);
+void mPORTBSetPinsDigitalOut(unsigned int);
+void mPORTBSetBits(unsigned int);
+void mPORTBClearBits(unsigned int);
+unsigned int mPORTAReadBits(unsigned int);
+unsigned int mPORTBReadBits(unsigned int);
+#define PPSOutput(group, pin, function) ((void)0)
+#define PPSInput(group, function, pin) ((void)0)
+
+// === system and interrupts ===
+#define SYS_CFG_WAIT_STATES 0
+#define SYS_CFG_PCACHE 0
+void SYSTEMConfig(unsigned int, unsigned int);
+void INTEnableSystemMultiVectoredInt(void);
+unsigned int INTDisableInterrupts(void);
+void INTRestoreInterrupts(unsigned int);
+#define INT_T2 2
+void INTEnable(int, int);
+
+// === core timer, sys_clock/2 ===
+unsigned int ReadCoreTimer(void);
+void OpenCoreTimer(unsigned int);
+void _CP0_SET_COMPARE(unsigned int);
+void mConfigIntCoreTimer(unsigned int);
+#define mCTClearIntFlag() ((void)0)
+#define CT_INT_ON 1
+#define CT_INT_PRIOR_1 1
+
+// === timers 2-5 ===
+#define T2_ON 0x8000
+#define T2_SOURCE_INT 0
+#define T2_PS_1_1 0
+#define T2_INT_ON 0x8
+#define T2_INT_PRIOR_2 2
+#define T3_ON T2_ON
+#define T3_SOURCE_INT 0
+#define T3_PS_1_1 0
+#define T3_INT_ON T2_INT_ON
+#define T3_INT_PRIOR_1 1
+#define T4_ON T2_ON
+#define T4_SOURCE_INT 0
+#define T4_PS_1_1 0
+#define T4_INT_ON T2_INT_ON
+#define T4_INT_PRIOR_1 1
+#define T5_ON T2_ON
+#define T5_SOURCE_INT 0
+#define T5_PS_1_1 0
+#define T5_INT_ON T2_INT_ON
+#define T5_INT_PRIOR_1 1
+#define OpenTimer2(config, period) host_timer_open(2, (config), (period))
+#define OpenTimer3(config, period) host_timer_open(3, (config), (period))
+#define OpenTimer4(config, period) host_timer_open(4, (config), (period))
+#define OpenTimer5(config, period) host_timer_open(5, (config), (period))
+#define CloseTimer2() host_timer_close(2)
+#define CloseTimer3() host_timer_close(3)
+#define CloseTimer4() host_timer_close(4)
+#define CloseTimer5() host_timer_close(5)
+#define ConfigIntTimer2(config) host_timer_int(2, (config))
+#define ConfigIntTimer3(config) host_timer_int(3, (config))
+#define ConfigIntTimer4(config) host_timer_int(4, (config))
+#define ConfigIntTimer5(config) host_timer_int(5, (config))
+#define mT2ClearIntFlag() ((void)0)
+#define mT3ClearIntFlag() ((void)0)
+#define mT4ClearIntFlag() ((void)0)
+#define mT5ClearIntFlag() ((void)0)
+
+// === external interrupt 2 ===
+#define EXT_INT_PRI_1 1
+#define FALLING_EDGE_INT 0
+#define EXT_INT_ENABLE 0x8000
+void ConfigINT2(unsigned int);
+#define EnableINT2 ((void)0)
+#define DisableINT2 ((void)0)
+#define mINT2ClearIntFlag() ((void)0)
+
+// === SPI2 ===
+typedef int SpiChannel;
+#define SPI_CHANNEL2 2
+#define SPI_OPEN_ON 0
+#define SPI_OPEN_MODE8 0
+#define SPI_OPEN_MODE16 0
+#define SPI_OPEN_MSTEN 0
+#define SPI_OPEN_CKE_REV 0
+void SpiChnOpen(int, unsigned int, unsigned int);
+void WriteSPI2(unsigned int);
+unsigned int ReadSPI2(void);
+int TxBufFullSPI2(void);
+
+// === ADC ===
+#define ADC_FORMAT_INTG16 0
+#define ADC_CLK_AUTO 0
+#define ADC_AUTO_SAMPLING_ON 0
+#define ADC_VREF_AVDD_AVSS 0
+#define ADC_OFFSET_CAL_DISABLE 0
+#define ADC_SCAN_ON 0
+#define ADC_SAMPLES_PER_INT_2 0
+#define ADC_ALT_BUF_OFF 0
+#define ADC_ALT_INPUT_OFF 0
+#define ADC_CONV_CLK_PB 0
+#define ADC_SAMPLE_TIME_15 0
+#define ADC_CONV_CLK_Tcy 0
+#define ENABLE_AN11_ANA 0
+#define ENABLE_AN5_ANA 0
+#define SKIP_SCAN_AN0 0
+#define SKIP_SCAN_AN1 0
+#define SKIP_SCAN_AN2 0
+#define SKIP_SCAN_AN3 0
+#define SKIP_SCAN_AN4 0
+#define SKIP_SCAN_AN6 0
+#define SKIP_SCAN_AN7 0
+#define SKIP_SCAN_AN8 0
+#define SKIP_SCAN_AN9 0
+#define SKIP_SCAN_AN10 0
+#define SKIP_SCAN_AN12 0
+#define SKIP_SCAN_AN13 0
+#define SKIP_SCAN_AN14 0
+#define SKIP_SCAN_AN15 0
+#define ADC_CH0_NEG_SAMPLEA_NVREF 0
+void CloseADC10(void);
+void EnableADC10(void);
+void SetChanADC10(unsigned int);
+void OpenADC10(unsigned int, unsigned int, unsigned int, unsigned int, unsigned int);
+unsigned int ReadADC10(int);
+
+// === UART ===
+#define UART1 1
+#define UART2 2
+#define UART_ENABLE_PINS_TX_RX_ONLY 0
+#define UART_DATA_SIZE_8_BITS 0
+#define UART_PARITY_NONE 0
+#define UART_STOP_BITS_1 0
+#define UART_ENABLE_FLAGS(flags) (flags)
+#define UART_PERIPHERAL 0
+#define UART_RX 0
+#define UART_TX 0
+#define _UART2_RX_IRQ 0
+#define _UART2_TX_IRQ 0
+void UARTConfigure(int, unsigned int);
+void UARTSetLineControl(int, unsigned int);
+void UARTSetDataRate(int, unsigned int, unsigned int);
+void UARTEnable(int, unsigned int);
+int UARTReceivedDataIsAvailable(int);
+int UARTTransmitterIsReady(int);
+unsigned char UARTGetDataByte(int);
+void UARTSendDataByte(int, unsigned char);
+void UART2ClearAllErrors(void);
+
+// === DMA ===
+typedef int DmaChannel;
+#define DMA_CHANNEL0 0
+#define DMA_CHANNEL1 1
+#define DMA_CHN_PRI2 2
+#define DMA_OPEN_MATCH 1
+#define DMA_OPEN_DEFAULT 0
+#define DMA_EV_START_IRQ_EN 0
+#define DMA_EV_MATCH_EN 0
+#define DMA_EV_START_IRQ(irq) 0
+#define DMA_EV_BLOCK_DONE 8
+void DmaChnOpen(int, int, int);
+void DmaChnSetMatchPattern(int, int);
+void DmaChnSetTxfer(int, const void *, void *, int, int, int);
+void DmaChnSetEventControl(int, int);
+void DmaChnSetEvEnableFlags(int, int);
+void DmaChnEnable(int);
+void DmaChnDisable(int);
+int DmaChnGetEvFlags(int);
+void DmaChnClrEvFlags(int, int);
+void DmaChnSetIntPriority(int, int, int);
+void DmaChnIntEnable(int);
+void DmaChnIntDisable(int);
+void DmaChnClrIntFlag(int);
+
+#endif	/* HOST_PLIB_H */
@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""Build the binary scene blob of scene.h from a text description.
+
+    python3 scene.py collegetown.scene -o scene.bin     the blob
+    python3 scene.py collegetown.scene -c ../scene_default.c
+    python3 scene.py my.scene --upload /dev/ttyUSB0      switch to it live
+
+One statement per line, '#' starts a comment. Times are in samples of
+the audio ISR, about 23988 a second. Noise, fm and contour frequencies
+are in Hz as heard; chirp, ramp and tones ones assume the lab's 44 kHz
+sample rate and play at 23988/44000 of their value.
+
+    listener start X Y bounds X0 Y0 X1 Y1 step N
+    blocked X0 Y0 X1 Y1             a rectangle the listener cannot enter
+    source NAME                     starts a source, at most three
+      voice chirp F0 SWEEP          F0 + SWEEP*t^2
+      voice ramp PERIOD RISE RISE0 FALL FALL0
+                                    t mod PERIOD: RISE*t + RISE0 the first
+                                    half, FALL*t + FALL0 the second
+      voice tones F1 T1 F2 T2       F1 until T1, F2 until T2, then silent
+      voice sample N                recording N of sample_bank.c, made by
+                                    wav2adpcm.py; the envelope still applies
+      voice noise LO HI PERIOD Q BAND [Q_HI]
+                                    white noise through a filter whose
+                                    cutoff goes from LO up to HI Hz (3000
+                                    at most) and back each PERIOD, and its
+                                    resonance from Q to Q_HI (0.7 up, Q if
+                                    not given) with it; BAND 1 band-pass,
+                                    0 low-pass
+      voice fm F RATIO INDEX0 INDEX1 DECAY
+                                    a sine at F Hz, phase modulated by one
+                                    at RATIO*F; the index (radians, 20 at
+                                    most) goes from INDEX0 to INDEX1 over
+                                    the first DECAY samples
+      voice contour N               pitch and level breakpoints N of
+                                    contour_bank.c, made by contour.py;
+                                    the envelope still applies
+      at X Y
+      level MAX CLAMP [threshold T] peak = MAX - attenuation, 0..CLAMP
+      atten K D0 C                  attenuation = K*log10(distance/D0) + C
+      envelope ATTACK DECAY SUSTAIN LENGTH
+      path X Y SPEED                moves from "at" to X Y at SPEED pixels
+                                    a second, then again from "at"
+    rect X Y W H COLOR [repeat N DX DY] [redraw] [occlude]
+    circle X Y R COLOR [repeat N DX DY] [redraw] [occlude]
+    triangle X0 Y0 X1 Y1 X2 Y2 COLOR [repeat N DX DY] [redraw] [occlude]
+
+t is the number of samples since the note started. COLOR is an
+ILI9340_ color name from tft_master.h, or an RGB565 number. repeat
+draws the shape N more times, each one moved by DX, DY. redraw marks
+a shape that is drawn again after the listener moves. occlude marks a
+building: sound between the listener and a source that crosses it is
+quieter and duller.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+import time
+
+from telemetry import FrameReader, crc16
+from tune import send, status_text
+
+MAGIC = 0x454e4353
+VERSION = 3
+SOURCES_MAX, BLOCKED_MAX, PRIMS_MAX = 3, 8, 64
+VOICES = {'none': (0, 0), 'chirp': (1, 2), 'ramp': (2, 5), 'tones': (3, 4),
+          'sample': (4, 1), 'noise': (5, 6),
+          'fm': (6, 5), 'contour': (7, 1)}
+PRIMS = {'rect': (0, 4), 'circle': (1, 3), 'triangle': (2, 6)}
+PRIM_REDRAW = 0x01
+PRIM_OCCLUDE = 0x02
+FRAME_SCENE = 0x04
+# blob bytes per upload frame, after the u16 offset
+CHUNK = 56
+LOAD_ERRORS = ('ok', 'bad header', 'bad version', 'bad length', 'bad CRC',
+               'too many items', 'bad listener', 'bad source', 'bad shape',
+               'over the audio ISR budget')
+
+
+def colors():
+    """The ILI9340_ color names of tft_master.h."""
+    here = os.path.dirname(os.path.abspath(__file__))
+    names = {}
+    with open(os.path.join(here, '..', 'tft_master.h')) as f:
+        for m in re.finditer(r'#define\s+ILI9340_(\w+)\s+(0x[0-9A-Fa-f]{4})\b',
+                             f.read()):
+            names[m.group(1).lower()] = int(m.group(2), 16)
+    return names
+
+
+class SceneError(Exception):
+    pass
+
+
+def parse(text):
+    scene = {'listener': None, 'blocked': [], 'sources': [], 'prims': []}
+    palette = colors()
+    src = None
+    for number, line in enumerate(text.splitlines(), 1):
+        words = line.split('#')[0].split()
+        if not words:
+            continue
+        try:
+            key, args = words[0], words[1:]
+            if key == 'listener':
+                opts = dict(zip(args[0::2], args[1::2]))
+                b = args[args.index('bounds') + 1:args.index('bounds') + 5]
+                scene['listener'] = (
+                    int(args[args.index('start') + 1]),
+                    int(args[args.index('start') + 2]),
+                    *[int(v) for v in b], int(opts['step']))
+            elif key == 'blocked':
+                scene['blocked'].append(tuple(int(v) for v in args[:4]))
+            elif key == 'source':
+                src = {'name': args[0], 'voice': ('none', []),
+                       'at': (0, 0), 'level': (0.0, 0.0, 0.0),
+                       'atten': (0.0, 1.0, 0.0), 'envelope': (1, 1, 0, 1),
+                       'path': None}
+                scene['sources'].append(src)
+            elif key in ('voice', 'at', 'level', 'atten', 'envelope', 'path'):
+                if src is None:
+                    raise SceneError('%s outside a source' % key)
+                if key == 'voice':
+                    n = VOICES[args[0]][1]
+                    src['voice'] = (args[0], [float(v) for v in args[1:1 + n]])
+                    # the resonance of a noise voice stays put without Q_HI
+                    if args[0] == 'noise' and len(src['voice'][1]) == n - 1:
+                        src['voice'][1].append(src['voice'][1][3])
+                    if len(src['voice'][1]) != n:
+                        raise SceneError('voice %s takes %d numbers' % (args[0], n))
+                elif key == 'at':
+                    src['at'] = (int(args[0]), int(args[1]))
+                elif key == 'path':
+                    src['path'] = (int(args[0]), int(args[1]), float(args[2]))
+                    if src['path'][2] < 0:
+                        raise SceneError('a path goes forward')
+                elif key == 'level':
+                    threshold = float(args[args.index('threshold') + 1]) \
+                        if 'threshold' in args else 0.0
+                    src['level'] = (float(args[0]), float(args[1]), threshold)
+                elif key == 'atten':
+                    src['atten'] = tuple(float(v) for v in args[:3])
+                else:
+                    src['envelope'] = tuple(int(v) for v in args[:4])
+            elif key in PRIMS:
+                kind, n = PRIMS[key]
+                v = [int(a) for a in args[:n]]
+                color = args[n]
+                color = palette[color.lower()] if color.lower() in palette \
+                    else int(color, 0)
+                rest = args[n + 1:]
+                repeat = dx = dy = 0
+                if 'repeat' in rest:
+                    i = rest.index('repeat')
+                    repeat, dx, dy = (int(a) for a in rest[i + 1:i + 4])
+                flags = (PRIM_REDRAW if 'redraw' in rest else 0) | \
+                    (PRIM_OCCLUDE if 'occlude' in rest else 0)
+                scene['prims'].append((kind, flags, repeat, dx, dy, color, v))
+            else:
+                raise SceneError('unknown statement %s' % key)
+        except (ValueError, IndexError, KeyError) as e:
+            raise SceneError('line %d: %s (%s)' % (number, line.strip(), e))
+        except SceneError as e:
+            raise SceneError('line %d: %s' % (number, e))
+    if scene['listener'] is None:
+        raise SceneError('no listener line')
+    if len(scene['sources']) > SOURCES_MAX:
+        raise SceneError('at most %d sources' % SOURCES_MAX)
+    if len(scene['blocked']) > BLOCKED_MAX:
+        raise SceneError('at most %d blocked rectangles' % BLOCKED_MAX)
+    if len(scene['prims']) > PRIMS_MAX:
+        raise SceneError('at most %d shapes' % PRIMS_MAX)
+    return scene
+
+
+def build(scene):
+    body = struct.pack('<hhhhhhH', *scene['listener'])
+    for b in scene['blocked']:
+        body += struct.pack('<hhhh', *b)
+    for s in scene['sources']:
+        name, params = s['voice']
+        params = (params + [0.0] * 6)[:6]
+        body += struct.pack('<B3x6f', VOICES[name][0], *params)
+        body += struct.pack('<hh', *s['at'])
+        body += struct.pack('<3f', *s['atten'])
+        body += struct.pack('<3f', *s['level'])
+        body += struct.pack('<4I', *s['envelope'])
+        body += struct.pack('<hhf', *(s['path'] or s['at'] + (0.0,)))
+    for kind, flags, repeat, dx, dy, color, v in scene['prims']:
+        v = (v + [0] * 6)[:6]
+        body += struct.pack('<BBBxbbH6h', kind, flags, repeat, dx, dy, color, *v)
+    length = 12 + len(body)
+    header = struct.pack('<IBBBBHH', MAGIC, VERSION, len(scene['sources']),
+                         len(scene['blocked']), len(scene['prims']),
+                         length, crc16(body))
+    return header + body
+
+
+def c_source(blob, source_name):
+    lines = ['// Generated by host/scene.py from %s -- do not edit' % source_name,
+             '#include "scene.h"', '',
+             'const unsigned char scene_default[] = {']
+    for i in range(0, len(blob), 12):
+        lines.append('    ' + ' '.join('0x%02x,' % b for b in blob[i:i + 12]))
+    lines += ['};', 'const int scene_default_len = sizeof(scene_default);', '']
+    return '\r\n'.join(lines)
+
+
+def upload(blob, port_name, baud):
+    import serial
+    port = serial.Serial(port_name, baud, timeout=0.05)
+    reader = FrameReader()
+    seq = int(time.time())
+    for offset in range(0, len(blob), CHUNK):
+        payload = struct.pack('<H', offset) + blob[offset:offset + CHUNK]
+        ack = send(port, reader, FRAME_SCENE, seq, payload)
+        seq += 1
+        if ack is None:
+            sys.exit('no answer at byte %d' % offset)
+        status, result = ack
+        if status != 0:
+            detail = LOAD_ERRORS[result] if result < len(LOAD_ERRORS) else result
+            sys.exit('refused at byte %d: %s (%s)'
+                     % (offset, status_text(status), detail))
+    print('%d bytes, the firmware switches within 500 mSec' % len(blob))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('scene', help='text description')
+    ap.add_argument('-o', metavar='FILE', help='write the blob')
+    ap.add_argument('-c', metavar='FILE', help='write the blob as scene_default')
+    ap.add_argument('--upload', metavar='PORT', help='send the blob over serial')
+    ap.add_argument('--baud', type=int, default=115200)
+    args = ap.parse_args()
+
+    with open(args.scene) as f:
+        try:
+            blob = build(parse(f.read()))
+        except SceneError as e:
+            sys.exit('%s: %s' % (args.scene, e))
+    if args.o:
+        with open(args.o, 'wb') as f:
+            f.write(blob)
+    if args.c:
+        with open(args.c, 'w', newline='') as f:
+            f.write(c_source(blob, os.path.basename(args.scene)))
+    if args.upload:
+        upload(blob, args.upload, args.baud)
+    if not (args.o or args.c or args.upload):
+        print('%d bytes' % len(blob))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,15 @@
+/*
+ * File:   stdfix.h (host build)
+ * The PIC32 compiler's _Accum is a 32-bit signed 16.15 fixed point type.
+ * The host build uses float for it: the synthesis sounds the same, but
+ * sums do not wrap and small increments are not rounded to 1/32768.
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef HOST_STDFIX_H
+#define	HOST_STDFIX_H
+
+#define _Accum float
+
+#endif	/* HOST_STDFIX_H */
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""Decode and plot the binary telemetry frames of audio_map.c.
+
+The firmware sends one FRAME_TELEMETRY frame per telemetry period once
+"b" has been typed on its serial port; "t 100" sets the period in mSec.
+The frame layout is in serial_frame.h, the payload is described above
+tlm_frame_build in audio_map.c.
+
+    python3 telemetry.py /dev/ttyUSB0              live plot
+    python3 telemetry.py /dev/ttyUSB0 --print      one line per frame
+    python3 telemetry.py capture.bin --print       decode a raw capture
+
+Needs pyserial for a port and matplotlib for the plot.
+"""
+import argparse
+import collections
+import struct
+import sys
+import time
+
+SYNC = b'\xa5\x5a'
+OVERHEAD = 7
+PAYLOAD_MAX = 160
+FRAME_TELEMETRY = 0x01
+TLM_VERSION = 1
+SOURCES = ('bird', 'car', 'bell')
+VECTORS = ('T2', 'T3', 'T4', 'T5', 'INT2')
+
+
+def crc16(data):
+    """CRC-16/CCITT, poly 0x1021, init 0xffff, as frame_crc16."""
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xffff
+    return crc
+
+
+class FrameReader:
+    """Finds frames in a byte stream; anything else is skipped."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.bad_crc = 0
+        self.lost = 0
+        self.seq = {}
+
+    def feed(self, data, final=False):
+        """Frames completed by data; final means no more data will come."""
+        self.buf += data
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                # keep a trailing first sync byte
+                del self.buf[:max(0, len(self.buf) - 1)]
+                return
+            del self.buf[:start]
+            if len(self.buf) < 5:
+                return
+            n = self.buf[4]
+            if n > PAYLOAD_MAX:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < OVERHEAD + n:
+                if not final:
+                    return
+                # a false sync near the end of a capture
+                del self.buf[:1]
+                continue
+            body = bytes(self.buf[2:5 + n])
+            crc = self.buf[5 + n] | self.buf[6 + n] << 8
+            if crc != crc16(body):
+                # a false sync in text or a damaged frame: hunt again
+                self.bad_crc += 1
+                del self.buf[:1]
+                continue
+            del self.buf[:OVERHEAD + n]
+            ftype, seq = body[0], body[1]
+            if ftype in self.seq:
+                self.lost += (seq - self.seq[ftype] - 1) & 0xff
+            self.seq[ftype] = seq
+            yield ftype, seq, body[3:]
+
+
+class Payload:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        v = struct.unpack_from('<' + fmt, self.data, self.pos)
+        self.pos += struct.calcsize('<' + fmt)
+        return v if len(v) > 1 else v[0]
+
+
+def decode_telemetry(data):
+    p = Payload(data)
+    t = {'version': p.take('B')}
+    if t['version'] != TLM_VERSION:
+        raise ValueError('telemetry version %d' % t['version'])
+    t['time'] = p.take('I') / 1000.0
+    t['interval'] = p.take('H')
+    t['x'], t['y'] = p.take('HH')
+    t['sources'] = {}
+    for name in SOURCES:
+        far, peak, gain, itd = p.take('BHHH')
+        t['sources'][name] = {'far_ear': 'LR'[far], 'peak': peak / 256.0,
+                              'gain': gain / 32767.0, 'itd': itd}
+    t['isr'] = {}
+    for name in VECTORS:
+        cpu, worst, late, overrun = p.take('HHHH')
+        t['isr'][name] = {'cpu': cpu / 100.0, 'max': worst,
+                          'late': late, 'overrun': overrun}
+    t['idle'] = p.take('B')
+    t['threads'] = []
+    for _ in range(p.take('B')):
+        worst, overruns, missed = p.take('HHH')
+        t['threads'].append({'max': worst, 'overruns': overruns,
+                             'missed': missed})
+    dac = p.take('HHHH')
+    t['dac'] = {'L': dac[0:2], 'R': dac[2:4]}
+    t['queue'] = p.take('H')
+    return t
+
+
+def format_telemetry(t):
+    src = ' '.join('%s %s%.2f/%.3f/%d' % (n, s['far_ear'], s['peak'],
+                                          s['gain'], s['itd'])
+                   for n, s in t['sources'].items())
+    isr = ' '.join('%s %.1f%%' % (n, v['cpu']) for n, v in t['isr'].items()
+                   if v['cpu'] or v['max'])
+    return ('%9.3f (%d,%d) %s | %s idle=%d%% | L %d..%d R %d..%d'
+            % (t['time'], t['x'], t['y'], src, isr, t['idle'],
+               t['dac']['L'][0], t['dac']['L'][1],
+               t['dac']['R'][0], t['dac']['R'][1]))
+
+
+def open_source(name, baud):
+    if name == '-':
+        return sys.stdin.buffer.read1 if hasattr(sys.stdin.buffer, 'read1') \
+            else sys.stdin.buffer.read, None
+    try:
+        f = open(name, 'rb')
+        return (lambda n: f.read(n)), None
+    except OSError:
+        pass
+    import serial
+    port = serial.Serial(name, baud, timeout=0.05)
+    return port.read, port
+
+
+def frames(read, reader, final=False):
+    """Telemetry read so far, or None when nothing was read."""
+    data = read(4096)
+    if not data and not final:
+        return None
+    out = []
+    for ftype, seq, payload in reader.feed(data, final):
+        if ftype == FRAME_TELEMETRY:
+            try:
+                out.append(decode_telemetry(payload))
+            except (ValueError, struct.error) as e:
+                print('bad telemetry frame:', e, file=sys.stderr)
+    return out
+
+
+def print_loop(read, reader, live):
+    while True:
+        out = frames(read, reader)
+        if out is None:
+            if live:
+                continue
+            out = frames(read, reader, final=True)
+            for t in out:
+                print(format_telemetry(t))
+            break
+        for t in out:
+            print(format_telemetry(t))
+    print('%d bad CRC, %d frames lost' % (reader.bad_crc, reader.lost),
+          file=sys.stderr)
+
+
+def plot_loop(read, reader, history):
+    import matplotlib.pyplot as plt
+    from matplotlib.animation import FuncAnimation
+
+    series = collections.defaultdict(lambda: collections.deque(maxlen=history))
+    fig, axes = plt.subplots(4, 1, sharex=True, figsize=(10, 9))
+    titles = ('listener', 'far/near gain', 'cpu %', 'DAC range')
+    for ax, title in zip(axes, titles):
+        ax.set_title(title, loc='left', fontsize='small')
+    lines = {}
+
+    def line(ax, key):
+        if key not in lines:
+            lines[key], = axes[ax].plot([], [], label=key)
+            axes[ax].legend(loc='upper left', fontsize='x-small')
+        return lines[key]
+
+    def update(_):
+        out = frames(read, reader) or []
+        for t in out:
+            series['time'].append(t['time'])
+            series['x'].append(t['x'])
+            series['y'].append(t['y'])
+            for n, s in t['sources'].items():
+                series[n].append(s['gain'])
+            for n, v in t['isr'].items():
+                series[n].append(v['cpu'])
+            series['busy'].append(100 - t['idle'])
+            for ear in 'LR':
+                series[ear + ' min'].append(t['dac'][ear][0])
+                series[ear + ' max'].append(t['dac'][ear][1])
+        if not out:
+            return list(lines.values())
+        groups = ((0, ('x', 'y')), (1, SOURCES), (2, VECTORS + ('busy',)),
+                  (3, ('L min', 'L max', 'R min', 'R max')))
+        for ax, keys in groups:
+            for key in keys:
+                line(ax, key).set_data(series['time'], series[key])
+            axes[ax].relim()
+            axes[ax].autoscale_view()
+        return list(lines.values())
+
+    anim = FuncAnimation(fig, update, interval=100, cache_frame_data=False)
+    plt.show()
+    return anim
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('source', help='serial port, capture file, or - for stdin')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--print', action='store_true',
+                    help='print one line per frame instead of plotting')
+    ap.add_argument('--period', type=int,
+                    help='set the telemetry period in mSec first, 40 at least')
+    ap.add_argument('--start', action='store_true',
+                    help='send "b" to turn the frames on (it toggles)')
+    ap.add_argument('--history', type=int, default=600,
+                    help='frames kept in the plot')
+    args = ap.parse_args()
+
+    read, port = open_source(args.source, args.baud)
+    if port is not None:
+        if args.period:
+            port.write(b't %d\r' % args.period)
+            time.sleep(0.1)
+        if args.start:
+            port.write(b'b\r')
+    reader = FrameReader()
+    if args.print:
+        print_loop(read, reader, port is not None)
+    else:
+        plot_loop(read, reader, args.history)
+
+
+if __name__ == '__main__':
+    main()
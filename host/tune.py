@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Set audio_map.c parameters at run time over the serial port.
+
+    python3 tune.py /dev/ttyUSB0 bell.attack=1500 bell.max=20.5
+    python3 tune.py /dev/ttyUSB0 listener.x=100 listener.y=200
+
+All settings on one command line go out in one FRAME_COMMAND frame and
+are applied together; the firmware answers with a FRAME_ACK. Names are
+listener.x, listener.y and <source>.<setting>. The source is bird, car
+or bell, or the slot number 0, 1 or 2 in another scene. The setting is
+x, y, max, threshold, attack, decay, sustain or length.
+Amplitudes may have a fraction, positions are pixels, times are samples.
+"""
+import argparse
+import struct
+import sys
+import time
+
+from telemetry import FrameReader, SOURCES, SYNC, crc16
+
+FRAME_COMMAND = 0x02
+FRAME_ACK = 0x03
+PARAMS = ('listener.x', 'listener.y', 'x', 'y', 'max', 'threshold',
+          'attack', 'decay', 'sustain', 'length')
+AMPLITUDES = ('max', 'threshold')
+STATUS = ('ok', 'bad length', 'bad setting', 'bad source', 'bad value',
+          'busy, try again', 'not a command', 'bad scene')
+# the firmware takes frames of up to 62 payload bytes
+RECORDS_MAX = 10
+
+
+def record(setting):
+    name, _, value = setting.partition('=')
+    if not value:
+        raise ValueError('%s: expected name=value' % setting)
+    if name.startswith('listener.'):
+        return PARAMS.index(name), 0, int(value)
+    source, _, param = name.partition('.')
+    # a slot number, or the name the default scene gives it
+    slot = int(source) if source.isdigit() else \
+        SOURCES.index(source) if source in SOURCES else -1
+    if not 0 <= slot < len(SOURCES) or param not in PARAMS[2:]:
+        raise ValueError('%s: unknown setting' % name)
+    if param in AMPLITUDES:
+        v = int(round(float(value) * 65536))
+    else:
+        v = int(value)
+    return PARAMS.index(param), slot, v
+
+
+def frame(ftype, seq, payload):
+    body = bytes((ftype, seq & 0xff, len(payload))) + payload
+    return SYNC + body + struct.pack('<H', crc16(body))
+
+
+def send(port, reader, ftype, seq, payload, retries=3):
+    """Sends a frame until it is acked; returns (status, record), or
+    None if the firmware never answered."""
+    for _ in range(retries):
+        port.write(frame(ftype, seq, payload))
+        deadline = time.time() + 1.0
+        while time.time() < deadline:
+            for rtype, _, ack in reader.feed(port.read(256)):
+                if rtype == FRAME_ACK and ack[0] == seq & 0xff:
+                    return ack[1], ack[2]
+    return None
+
+
+def status_text(status):
+    return STATUS[status] if status < len(STATUS) else str(status)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('port')
+    ap.add_argument('settings', nargs='+', metavar='name=value')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--retries', type=int, default=3)
+    args = ap.parse_args()
+
+    try:
+        records = [record(s) for s in args.settings]
+    except ValueError as e:
+        sys.exit(str(e))
+    if len(records) > RECORDS_MAX:
+        sys.exit('at most %d settings at a time' % RECORDS_MAX)
+    payload = b''.join(struct.pack('<BBi', *r) for r in records)
+
+    import serial
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    ack = send(port, FrameReader(), FRAME_COMMAND, int(time.time()), payload,
+               args.retries)
+    if ack is None:
+        sys.exit('no answer')
+    status, bad = ack
+    if status != 0:
+        sys.exit('refused: %s (%s)' % (status_text(status), args.settings[bad]))
+    print('ok, applied within 500 mSec')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Convert WAV files into the IMA-ADPCM sample bank of adpcm.h.
+
+    python3 wav2adpcm.py -o ../sample_bank.c bird.wav car.wav@0.2-1.4
+
+Each WAV becomes one sample, numbered in the order given; a scene plays
+it with "voice sample N". FILE@START-END loops it from START to END
+seconds once it has played up to END; START is moved back to a block
+boundary. Stereo files are mixed to mono, and everything is resampled
+to the audio ISR rate. With no files the bank is empty.
+"""
+import argparse
+import os
+import struct
+import sys
+import wave
+
+BLOCK = 64
+# pb_clock/(SAMPLE_PERIOD + 1) in audio_map.c
+RATE = 64000000 / 2668
+
+STEPS = (
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767)
+INDEX_STEP = (-1, -1, -1, -1, 2, 4, 6, 8) * 2
+
+
+def read_wav(name):
+    """Mono samples, -32768..32767, and the rate of the file."""
+    with wave.open(name) as w:
+        width, channels, rate = w.getsampwidth(), w.getnchannels(), w.getframerate()
+        data = w.readframes(w.getnframes())
+    if width == 1:
+        values = [(b - 128) << 8 for b in data]
+    elif width == 2:
+        values = list(struct.unpack('<%dh' % (len(data) // 2), data))
+    else:
+        sys.exit('%s: only 8 and 16 bit WAV files' % name)
+    mono = [sum(values[i:i + channels]) // channels
+            for i in range(0, len(values), channels)]
+    return mono, rate
+
+
+def resample(pcm, rate_in, rate_out):
+    """Linear interpolation; enough for field recordings on a 12 bit DAC."""
+    n = int(len(pcm) * rate_out / rate_in)
+    out = []
+    for i in range(n):
+        t = i * rate_in / rate_out
+        k = int(t)
+        a = pcm[k]
+        b = pcm[k + 1] if k + 1 < len(pcm) else a
+        out.append(int(round(a + (b - a) * (t - k))))
+    return out
+
+
+def decode_step(code, predictor, index):
+    """One sample of adpcm_next, the encoder follows the decoder exactly."""
+    step = STEPS[index]
+    diff = step >> 3
+    if code & 4:
+        diff += step
+    if code & 2:
+        diff += step >> 1
+    if code & 1:
+        diff += step >> 2
+    predictor += -diff if code & 8 else diff
+    predictor = max(-32768, min(32767, predictor))
+    index = max(0, min(88, index + INDEX_STEP[code]))
+    return predictor, index
+
+
+def encode(pcm):
+    """The blocks of adpcm.h, and the decoded samples."""
+    out, decoded = bytearray(), []
+    predictor, index = 0, 0
+    for start in range(0, len(pcm), BLOCK):
+        out += struct.pack('<hBx', predictor, index)
+        codes = []
+        for s in pcm[start:start + BLOCK]:
+            step = STEPS[index]
+            diff = s - predictor
+            code = 0
+            if diff < 0:
+                code, diff = 8, -diff
+            if diff >= step:
+                code |= 4
+                diff -= step
+            if diff >= step >> 1:
+                code |= 2
+                diff -= step >> 1
+            if diff >= step >> 2:
+                code |= 1
+            predictor, index = decode_step(code, predictor, index)
+            codes.append(code)
+            decoded.append(predictor)
+        codes += [0] * (BLOCK - len(codes))
+        out += bytes(codes[i] | codes[i + 1] << 4 for i in range(0, BLOCK, 2))
+    return bytes(out), decoded
+
+
+def snr(pcm, decoded):
+    import math
+    signal = sum(s * s for s in pcm) or 1
+    noise = sum((s - d) ** 2 for s, d in zip(pcm, decoded)) or 1
+    return 10 * math.log10(signal / noise)
+
+
+def c_source(samples):
+    lines = ['// Generated by host/wav2adpcm.py -- do not edit',
+             '#include <stddef.h>',
+             '#include "adpcm.h"', '']
+    for n, (name, blocks, length, loop) in enumerate(samples):
+        lines.append('// %d: %s, %d samples' % (n, name, length))
+        lines.append('static const unsigned char sample_%d[] = {' % n)
+        for i in range(0, len(blocks), 12):
+            lines.append('    ' + ' '.join('0x%02x,' % b for b in blocks[i:i + 12]))
+        lines += ['};', '']
+    if samples:
+        lines.append('const struct adpcm_sample sample_bank[] = {')
+        for n, (name, blocks, length, loop) in enumerate(samples):
+            lines.append('    {sample_%d, %d, %d, %d},' % ((n, length) + loop))
+        lines += ['};', 'const int sample_bank_len = %d;' % len(samples), '']
+    else:
+        # C has no empty arrays
+        lines += ['const struct adpcm_sample sample_bank[1] = {{NULL, 0, 0, 0}};',
+                  'const int sample_bank_len = 0;', '']
+    return '\r\n'.join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('wav', nargs='*', help='FILE or FILE@START-END')
+    ap.add_argument('-o', metavar='FILE', required=True, help='the C bank')
+    ap.add_argument('--rate', type=float, default=RATE,
+                    help='playback rate, %.0f Hz by default' % RATE)
+    args = ap.parse_args()
+
+    samples, total = [], 0
+    for arg in args.wav:
+        name, _, loop = arg.partition('@')
+        pcm, rate = read_wav(name)
+        pcm = resample(pcm, rate, args.rate)
+        if not pcm:
+            sys.exit('%s: no samples' % name)
+        loop_points = (0, 0)
+        if loop:
+            try:
+                start, end = (float(v) for v in loop.split('-'))
+            except ValueError:
+                sys.exit('%s: loop is START-END in seconds' % arg)
+            start = int(start * args.rate) // BLOCK * BLOCK
+            end = min(int(end * args.rate), len(pcm))
+            if end <= start:
+                sys.exit('%s: the loop ends before it starts' % arg)
+            loop_points = (start, end)
+        blocks, decoded = encode(pcm)
+        samples.append((os.path.basename(name), blocks, len(pcm), loop_points))
+        total += len(blocks)
+        print('%d: %s, %.2f s, %d bytes, SNR %.1f dB%s' % (
+            len(samples) - 1, name, len(pcm) / args.rate, len(blocks),
+            snr(pcm, decoded),
+            ', loop %d-%d' % loop_points if loop else ''))
+    with open(args.o, 'w', newline='') as f:
+        f.write(c_source(samples))
+    print('%d samples, %d bytes of flash' % (len(samples), total))
+
+
+if __name__ == '__main__':
+    main()
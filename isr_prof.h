@@ -0,0 +1,82 @@
+/*
+ * File:   isr_prof.h
+ * Per-vector ISR execution time profiler
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef ISR_PROF_H
+#define	ISR_PROF_H
+/* Each profiled ISR reads the core timer (sys_clock/2) at entry and at
+ * exit and folds the difference into the min/max/total and a histogram
+ * for its vector. That costs two mfc0 reads and a dozen instructions
+ * per interrupt. The stats of one vector are only written by its own
+ * ISR, and a thread takes a consistent copy with isr_prof_snapshot.
+ *
+ * Compiled in when use_isr_profiler is defined in config_1_3_2.h;
+ * otherwise the ISR macros are empty.
+ */
+#include <string.h>
+
+// histogram bins are ISR_PROF_BIN_TICKS core ticks wide, the last bin
+// holds everything longer
+#define ISR_PROF_BINS 16
+#define ISR_PROF_BIN_SHIFT 7
+#define ISR_PROF_BIN_TICKS (1 << ISR_PROF_BIN_SHIFT)
+// convert core timer ticks to peripheral bus clocks (timer counts)
+#define ISR_PROF_PB_PER_TICK ((pb_clock)/(sys_clock/2))
+
+struct isr_prof {
+    unsigned int count;           // ISR runs
+    unsigned int min, max;        // core timer ticks from entry to exit
+    unsigned long long total;
+    unsigned int late;            // entered more than the allowed latency after its event
+    unsigned int overrun;         // its next event was already pending at exit
+    unsigned int hist[ISR_PROF_BINS];
+};
+
+static inline void isr_prof_record(struct isr_prof *p, unsigned int ticks)
+{
+    unsigned int bin = ticks >> ISR_PROF_BIN_SHIFT;
+    p->count++;
+    p->total += ticks;
+    if (ticks < p->min) p->min = ticks;
+    if (ticks > p->max) p->max = ticks;
+    p->hist[bin < ISR_PROF_BINS ? bin : ISR_PROF_BINS-1]++;
+}
+
+static inline void isr_prof_reset(struct isr_prof *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->min = 0xffffffff;
+}
+
+// copy one vector's stats with interrupts off, optionally clearing them;
+// thread level only
+static inline void isr_prof_snapshot(struct isr_prof *p, struct isr_prof *copy, int reset)
+{
+    unsigned int status = INTDisableInterrupts();
+    *copy = *p;
+    if (reset) isr_prof_reset(p);
+    INTRestoreInterrupts(status);
+}
+
+#ifdef use_isr_profiler
+// first statement of the ISR
+#define ISR_PROF_ENTER() unsigned int isr_prof_start = ReadCoreTimer()
+// last statement of the ISR
+#define ISR_PROF_EXIT(p) isr_prof_record((p), ReadCoreTimer() - isr_prof_start)
+// for periodic timers: the count since the period match shows how long
+// the ISR waited to start, a pending flag at exit means it overran
+#define ISR_PROF_LATENCY(p, timer_count, limit) \
+    do { if ((timer_count) > (limit)) (p)->late++; } while(0)
+#define ISR_PROF_OVERRUN(p, pending) \
+    do { if (pending) (p)->overrun++; } while(0)
+#else
+#define ISR_PROF_ENTER()
+#define ISR_PROF_EXIT(p)
+#define ISR_PROF_LATENCY(p, timer_count, limit)
+#define ISR_PROF_OVERRUN(p, pending)
+#endif
+
+#endif	/* ISR_PROF_H */
@@ -0,0 +1,77 @@
+/*
+ * File:   noise.h
+ * Noise voices: an LFSR through a state variable filter, for traffic,
+ * wind and crowds
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef NOISE_H
+#define	NOISE_H
+/* The noise is one bit a sample of a 32 bit Galois LFSR, as +-level,
+ * so it is white. It goes through a Chamberlin state variable filter,
+ *   low += f*band; high = in - low - damp*band; band += f*high
+ * all integer Q15, whose low-pass output is a rumble and whose
+ * band-pass output a whistle. The cutoff moves between two
+ * frequencies, up over the first half of a period and back down over
+ * the second, and the damping between two resonances with it; both
+ * are worked out every NOISE_CONTROL samples. The timer thread turns
+ * the scene's Hz and Q into a struct noise_voice; the ISR does a
+ * shift, an xor and three multiplies a sample.
+ *
+ * Both ears restart the same sequence with each note, so the far ear
+ * hears the near ear's noise after the ITD.
+ */
+
+#define NOISE_CONTROL 64
+#define NOISE_SEED 0xace1u
+// x^32 + x^22 + x^2 + x + 1, maximal length
+#define NOISE_TAPS 0x80200003u
+// a sample of full scale, as the sine table's 1.0
+#define NOISE_ONE ((_Accum)(1.0/32768))
+// the filter is stable up to Fs/8 for Q from 0.7 up
+#define NOISE_FC_MAX 3000
+#define NOISE_Q_MIN 0.7
+
+// a noise voice, ready for the ISR
+struct noise_voice {
+    int f_lo;                       // cutoff coefficient 2*sin(pi*fc/Fs), Q15
+    int slope;                      // its change a sample, 1/65536 of Q15
+    unsigned int period;            // samples
+    int damp;                       // 1/Q at f_lo, Q15
+    int damp_slope;                 // its change a sample, 1/256 of Q15
+    int level;                      // input, Q15
+    int band;                       // band-pass instead of low-pass
+};
+
+// one playback of a noise voice
+struct noise_state {
+    unsigned int lfsr;
+    int low, band, f, damp;
+};
+
+/* The next sample, Q15, t samples into the note. */
+static inline int noise_next(struct noise_state *st, const struct noise_voice *v,
+    unsigned int t)
+{
+    int in, high;
+    unsigned int tri;
+    if (t % NOISE_CONTROL == 0) {
+        if (t == 0) {
+            st->lfsr = NOISE_SEED;
+            st->low = st->band = 0;
+        }
+        tri = t % v->period;
+        if (tri >= v->period/2) tri = v->period - tri;
+        st->f = v->f_lo + (((int)tri*v->slope) >> 16);
+        st->damp = v->damp + (((int)tri*v->damp_slope) >> 8);
+    }
+    st->lfsr = (st->lfsr >> 1) ^ (-(st->lfsr & 1) & NOISE_TAPS);
+    in = (st->lfsr & 1)? v->level : -v->level;
+    st->low += (st->f*st->band) >> 15;
+    high = in - st->low - ((st->damp*st->band) >> 15);
+    st->band += (st->f*high) >> 15;
+    return v->band ? st->band : st->low;
+}
+
+#endif	/* NOISE_H */
@@ -0,0 +1,66 @@
+#include "port_expander_brl4.h"
+#include "pe_keys.h"
+
+SPSC_QUEUE(key_queue, 16);
+volatile int pe_keys_irq;
+// the pins used as keys, and the ones held down after the last stable read
+static unsigned short pe_key_mask, pe_keys_down;
+// events lost because nobody emptied key_queue
+unsigned int pe_keys_dropped;
+
+void pe_keys_init(unsigned short mask) {
+  pe_key_mask = mask;
+  mPortYSetPinsIn(mask & 0xff);
+  mPortZSetPinsIn(mask >> 8);
+  mPortYEnablePullUp(mask & 0xff);
+  mPortZEnablePullUp(mask >> 8);
+  // interrupt on any change, not against DEFVAL
+  clearBits(INTCONY, mask & 0xff);
+  clearBits(INTCONZ, mask >> 8);
+  // both ports on one INT pin, active low push-pull
+  setBits(IOCON, SET_MIRROR);
+  mPortYIntEnable(mask & 0xff);
+  mPortZIntEnable(mask >> 8);
+  // start from the keys as they are now, this also clears any old interrupt
+  pe_keys_down = ~readPE16(GPIOY) & mask;
+  readPE16(INTCAPY);
+
+  // INT2 is in PPS input group 3
+  mPORTASetPinsDigitalIn(BIT_2);
+  PPSInput(3, INT2, RPA2);
+  // same level as the ITD timers, below the audio ISR
+  ConfigINT2(EXT_INT_PRI_1 | FALLING_EDGE_INT | EXT_INT_ENABLE);
+  pe_keys_arm();
+}
+
+void pe_keys_isr(void) {
+  mINT2ClearIntFlag();
+  DisableINT2;
+  pe_keys_irq = 1;
+}
+
+int pe_keys_read(void) {
+  // INTFY INTFZ INTCAPY INTCAPZ GPIOY GPIOZ -- 8 bytes, two 32-bit words
+  unsigned char reg[6];
+  unsigned short changed, down;
+  int key;
+  readPEBurst(INTFY, reg, 6);
+  // a pin changed since the previous burst: still bouncing
+  if ((reg[0] | (reg[1] << 8)) & pe_key_mask) return 0;
+
+  down = ~(reg[4] | (reg[5] << 8)) & pe_key_mask;
+  changed = down ^ pe_keys_down;
+  for (key = 0; changed; key++, changed >>= 1) {
+    if ((changed & 1) && !spsc_put(&key_queue, KEY_EVENT(key, (down >> key) & 1)))
+      pe_keys_dropped++;
+  }
+  pe_keys_down = down;
+  return 1;
+}
+
+void pe_keys_arm(void) {
+  mINT2ClearIntFlag();
+  EnableINT2;
+  // the edge is lost if INT went low between the last burst and now
+  if (!mPORTAReadBits(BIT_2)) pe_keys_irq = 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * File:   pe_keys.h
+ * Interrupt driven key input on the MCP23S17 port expander
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef PE_KEYS_H
+#define	PE_KEYS_H
+/* Keys are expander pins with pull-ups, pressed = pin pulled low. The
+ * expander interrupts on any change, with INTA and INTB mirrored onto one
+ * pin, which goes to external interrupt INT2:
+ *  -- INT - RPA2 (Pin 9)
+ * Nothing is read from the expander until it interrupts. Then the key
+ * thread reads INTF, INTCAP and GPIO in a single 8-byte burst (reading
+ * INTCAP and GPIO also releases INT) and repeats that every
+ * PE_KEY_DEBOUNCE_msec until a burst shows no new change. The pins are
+ * then stable, and every key that differs from the last stable state
+ * is posted to key_queue.
+ *
+ * INT2 stays off from the first edge until the keys are stable again, so
+ * a bouncing contact costs one interrupt and a few bursts.
+ */
+#include "spsc_queue.h"
+
+// a key must sit still this long to count
+#define PE_KEY_DEBOUNCE_msec 10
+
+// key events: key number 0-7 = Y0-Y7, 8-15 = Z0-Z7
+#define KEY_EVENT(key, down) (((key) << 1) | (down))
+#define KEY_NUM(ev)  ((ev) >> 1)
+#define KEY_DOWN(ev) ((ev) & 1)
+
+// debounced key events, from the key thread to any one consumer thread
+extern struct spsc_queue key_queue;
+
+// set by the INT2 ISR, cleared by the key thread
+extern volatile int pe_keys_irq;
+
+/* Makes the pins in mask (Y in the low byte) key inputs and turns on
+ * INT2. initPE must have been called. */
+void pe_keys_init(unsigned short mask);
+
+/* For the INT2 ISR: turns INT2 off and flags the key thread. */
+void pe_keys_isr(void);
+
+/* One INTF/INTCAP/GPIO burst. Returns 1 and posts key events if no pin
+ * changed since the previous burst, 0 if they are still bouncing. */
+int pe_keys_read(void);
+
+/* Turns INT2 back on once the keys are stable. */
+void pe_keys_arm(void);
+
+#endif	/* PE_KEYS_H */
@@ -3,22 +3,20 @@
 #define SET_CS    {mPORTBSetBits(BIT_9);}
 #define CLEAR_CS  {mPORTBClearBits(BIT_9);}
 
-// === spi bit widths ====================================================
-// hit the SPI control register directly, SPI2
-// Change the SPI bit modes on the fly, mid-transaction if necessary
-inline void SPI_Mode16(void){  // configure SPI2 for 16-bit mode
-    SPI2CONSET = 0x400;
-    SPI2CONCLR = 0x800;
-}
-// ========
-inline void SPI_Mode8(void){  // configure SPI2 for 8-bit mode
-    SPI2CONCLR = 0x400;
-    SPI2CONCLR = 0x800;
-}
-// ========
-inline void SPI_Mode32(void){  // configure SPI2 for 32-bit mode
-    SPI2CONCLR = 0x400;
-    SPI2CONSET = 0x800;
+// === shadow registers ===================================================
+// Last value written to every register the expander never changes by
+// itself, so read-modify-write needs no read. INTF, INTCAP and GPIO
+// are inputs and always come from the chip; writing GPIO writes OLAT.
+static unsigned char pe_shadow[OLATZ+1];
+#define PE_CACHED(addr) ((addr) < INTFY || (addr) >= OLATY)
+#define PE_SHADOW_ADDR(addr) (((addr) == GPIOY || (addr) == GPIOZ)? (addr)+2 : (addr))
+
+// record a write in the shadow copy
+static void pe_shadow_write(unsigned char addr, unsigned char data){
+  addr = PE_SHADOW_ADDR(addr);
+  if (addr <= OLATZ && PE_CACHED(addr)) pe_shadow[addr] = data;
+  // IOCON shows up at two addresses
+  if (addr == IOCON || addr == IOCON+1) pe_shadow[IOCON] = pe_shadow[IOCON+1] = data;
 }
 
 void initPE() {
@@ -27,42 +25,62 @@ void initPE() {
   volatile int spiClkDiv = 4; // 10 MHz max speed for this DAC
   mPORTBSetPinsDigitalOut(BIT_9); // use RPB9 (pin 21)
   mPORTBSetBits(BIT_9); // CS active low
-  PPSOutput(2, RPB5, SDO2); // use RPB5 (pin 14) for SDO2
   PPSInput(3, SDI2,RPA4); // SDI2
   
-  SpiChnOpen(pe_spi, SPI_OPEN_ON | SPI_OPEN_MODE8 | SPI_OPEN_MSTEN | SPI_OPEN_CKE_REV, spiClkDiv);
+  // SDO2 on RPB5 (pin 14); the bus is shared with the DAC
+  spi2_bus_init();
   
-  writePE(IOCON, ( CLEAR_BANK   | CLEAR_MIRROR | SET_SEQOP |
+  // sequential operation ON so bursts walk through adjacent registers
+  writePE(IOCON, ( CLEAR_BANK   | CLEAR_MIRROR | CLEAR_SEQOP |
                    CLEAR_DISSLW | CLEAR_HAEN   | CLEAR_ODR |
                    CLEAR_INTPOL ));
+  // put the chip in its power-on state (it may not have been reset with
+  // the PIC) so that the shadow registers match it: all inputs, no pull
+  // ups, no interrupts
+  writePE16(IODIRY,   0xffff);
+  writePE16(IPOLY,    0x0000);
+  writePE16(GPINTENY, 0x0000);
+  writePE16(DEFVALY,  0x0000);
+  writePE16(INTCONY,  0x0000);
+  writePE16(GPPUY,    0x0000);
+  writePE16(OLATY,    0x0000);
+}
+
+// current value of a register: from the shadow copy when there is one
+static unsigned char pe_current(unsigned char addr){
+  unsigned char shadow_addr = PE_SHADOW_ADDR(addr);
+  if (PE_CACHED(shadow_addr)) return pe_shadow[shadow_addr];
+  return readPE(addr);
 }
 
 void clearBits(unsigned char addr, unsigned char bitmask){
   if (addr <= 0x15){
-    unsigned char cur_val = readPE(addr);
+    unsigned char cur_val = pe_current(addr);
     writePE(addr, cur_val & (~bitmask));
   }
 }
 
 void setBits(unsigned char addr, unsigned char bitmask){
   if (addr <= 0x15){
-    unsigned char cur_val = readPE(addr);
+    unsigned char cur_val = pe_current(addr);
     writePE(addr, cur_val | (bitmask));
   }
 }
 
 void toggleBits(unsigned char addr, unsigned char bitmask){
   if (addr <= 0x15){
-    unsigned char cur_val = readPE(addr);
+    unsigned char cur_val = pe_current(addr);
     writePE(addr, cur_val ^ (bitmask));
   }
 }
 
 unsigned char readBits(unsigned char addr, unsigned char bitmask){
   if (addr <= 0x15){
-    unsigned char cur_val = readPE(addr) & bitmask ;
+    // pins and interrupt flags are read from the chip, the rest is cached
+    unsigned char cur_val = (PE_CACHED(addr)? pe_shadow[addr] : readPE(addr)) & bitmask ;
     return cur_val ;
   }
+  return 0;
 }
 
 void mPortYSetPinsOut(unsigned char bitmask){
@@ -114,71 +132,81 @@ void mPortZDisablePullUp(unsigned char bitmask){
 }
 
 inline void writePE(unsigned char reg_addr, unsigned char data) {
-  unsigned char junk = 0;
-   
-  // test for ready
-  while (TxBufFullSPI2());
-  
-  // CS low to start transaction
-  CLEAR_CS
-  // 8-bits
-  SPI_Mode8();
-  // OPCODE and HW Address (Should always be 0b0100000), set LSB for write
-  WriteSPI2((PE_OPCODE_HEADER | WRITE));
-  // test for done
-  while (SPI2STATbits.SPIBUSY); // wait for byte to be sent
-  junk = ReadSPI2();
+  struct spi2_xfer x;
+  x.cs = BIT_9;
+  x.len = 3;
+  // OPCODE and HW Address (Should always be 0b0100000), clear LSB for write
+  x.tx[0] = PE_OPCODE_HEADER | WRITE;
   // Input Register Address
-
-  WriteSPI2(reg_addr);
-  while (SPI2STATbits.SPIBUSY); // wait for byte to be sent
-  junk = ReadSPI2();
+  x.tx[1] = reg_addr;
   // One byte of data to write to register
-  
-  WriteSPI2(data);
-  // test for done
-  while (SPI2STATbits.SPIBUSY); // wait for end of transaction
-  junk = ReadSPI2();
-  // CS high
-  SET_CS
-  
+  x.tx[2] = data;
+  // goes out between two audio samples if the DAC is running
+  spi2_run(&x);
+  pe_shadow_write(reg_addr, data);
 }
 
 inline unsigned char readPE(unsigned char reg_addr) {
-  unsigned char out = 0;
-  
-  // test for ready
-  while (TxBufFullSPI2());
-  
-  // CS low to start transaction
-  CLEAR_CS
-  
-  // 8-bits
-  SPI_Mode8();
-  // OPCODE and HW Address (Should always be 0b0100000), clear LSB for write
-  WriteSPI2((PE_OPCODE_HEADER | READ));
-  // test for done
-  while (SPI2STATbits.SPIBUSY); // wait for byte to be sent
-  out = ReadSPI2(); //junk
+  struct spi2_xfer x;
+  x.cs = BIT_9;
+  x.len = 3;
+  // OPCODE and HW Address (Should always be 0b0100000), set LSB for read
+  x.tx[0] = PE_OPCODE_HEADER | READ;
   // Input Register Address
-  // test for ready
-  while (TxBufFullSPI2());
-  // 8-bits
-  
-  WriteSPI2(reg_addr);
-  while (SPI2STATbits.SPIBUSY); // wait for byte to be sent
-  out = ReadSPI2(); // junk
-  // One byte of dummy data to write to register
-  // test for ready
-  while (TxBufFullSPI2());
-  // 8-bits
-  
-  WriteSPI2(out);
-  // test for done
-  while (SPI2STATbits.SPIBUSY); // wait for end of transaction
-  out = ReadSPI2(); // bingo
-  // CS high
-  SET_CS
-  
-  return out;
+  x.tx[1] = reg_addr;
+  // One byte of dummy data, register comes back at the same time
+  x.tx[2] = 0;
+  // goes out between two audio samples if the DAC is running
+  spi2_run(&x);
+  return x.rx[2]; // bingo
+}
+
+// write n adjacent registers starting at reg_addr in one transaction
+void writePEBurst(unsigned char reg_addr, const unsigned char *data, int n) {
+  struct spi2_xfer x;
+  int i;
+  if (n > PE_BURST_MAX) n = PE_BURST_MAX;
+  x.cs = BIT_9;
+  x.len = n + 2;
+  x.tx[0] = PE_OPCODE_HEADER | WRITE;
+  x.tx[1] = reg_addr;
+  for (i = 0; i < n; i++) x.tx[i+2] = data[i];
+  spi2_run(&x);
+  for (i = 0; i < n; i++) pe_shadow_write(reg_addr + i, data[i]);
+}
+
+// write a Y/Z register pair, Y in the low byte; 4 bytes go out as
+// a single 32-bit SPI word
+void writePE16(unsigned char reg_addr, unsigned short data) {
+  unsigned char bytes[2];
+  bytes[0] = data & 0xff;
+  bytes[1] = data >> 8;
+  writePEBurst(reg_addr, bytes, 2);
+}
+
+// read a Y/Z register pair in one 32-bit SPI word, Y in the low byte
+unsigned short readPE16(unsigned char reg_addr) {
+  struct spi2_xfer x;
+  x.cs = BIT_9;
+  x.len = 4;
+  x.tx[0] = PE_OPCODE_HEADER | READ;
+  x.tx[1] = reg_addr;
+  x.tx[2] = 0;
+  x.tx[3] = 0;
+  spi2_run(&x);
+  return x.rx[2] | (x.rx[3] << 8);
+}
+
+// read n adjacent registers starting at reg_addr in one transaction
+void readPEBurst(unsigned char reg_addr, unsigned char *data, int n) {
+  struct spi2_xfer x;
+  int i;
+  if (n > PE_BURST_MAX) n = PE_BURST_MAX;
+  x.cs = BIT_9;
+  x.len = n + 2;
+  x.tx[0] = PE_OPCODE_HEADER | READ;
+  x.tx[1] = reg_addr;
+  for (i = 0; i < n; i++) x.tx[i+2] = 0;
+  spi2_run(&x);
+  for (i = 0; i < n; i++) data[i] = x.rx[i+2];
 }
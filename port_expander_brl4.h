@@ -9,6 +9,7 @@
 #define	PORT_EXPANDER_H
 /* Library for interacting with MCP23S17 port expander */
 #include "plib.h"
+#include "spi2_bus.h"
 
 #define PE_OPCODE_HEADER 0b01000000
 #define READ 0b00000001
@@ -100,7 +101,35 @@ inline void writePE(unsigned char, unsigned char);
  * target register. */
 inline unsigned char readPE(unsigned char);
 
-// spi2 lock so that port expander OR DAC can use the channel
-extern volatile int spi2_lock ;
+/* The driver keeps a shadow copy of every register it writes, except the
+ * input registers (INTF, INTCAP, GPIO), so setBits/clearBits/toggleBits
+ * need a single write. IOCON is set up with sequential operation so the
+ * functions below move several adjacent registers in one transaction. */
+
+// most registers in one burst write
+#define PE_BURST_MAX (SPI2_XFER_MAX-2)
+
+/* Writes n adjacent registers starting at the given address, in one
+ * transaction. */
+void writePEBurst(unsigned char, const unsigned char *, int);
+
+/* Writes a Y/Z register pair (e.g. IODIRY and IODIRZ), Y in the low byte. */
+void writePE16(unsigned char, unsigned short);
+
+/* Reads a Y/Z register pair in one 32-bit transfer, e.g. GPIOY and GPIOZ
+ * together, Y in the low byte. */
+unsigned short readPE16(unsigned char);
+
+/* Reads n adjacent registers starting at the given address, in one
+ * transaction. */
+void readPEBurst(unsigned char, unsigned char *, int);
+
+void clearBits(unsigned char, unsigned char);
+void setBits(unsigned char, unsigned char);
+void toggleBits(unsigned char, unsigned char);
+unsigned char readBits(unsigned char, unsigned char);
+
+// SPI2 is shared with the DAC through spi2_bus.h; expander transactions
+// are interleaved with the audio samples, so no lock is needed
 #endif	/* PORT_EXPANDER_H */
 
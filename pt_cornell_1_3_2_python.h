@@ -543,12 +543,32 @@ struct pt_sem {
 
 #define PT_YIELD_TIME_msec(delay_time)  \
     do { static unsigned int time_thread ;\
-    time_thread = time_tick_millsec + (unsigned int)delay_time ; \
-    PT_YIELD_UNTIL(pt, (time_tick_millsec >= time_thread)); \
+    time_thread = PT_GET_TIME() + (unsigned int)delay_time ; \
+    PT_YIELD_UNTIL(pt, PT_WAKE_AT(time_thread)); \
+    PT_CHECK_DEADLINE(time_thread); \
     } while(0);
 
+// true when wake_time has come, otherwise tells the idle scheduler
+// when this thread wants to run again
+#define PT_WAKE_AT(wake_time) \
+    ((PT_GET_TIME() >= (wake_time)) || pt_note_wake(wake_time))
+
+// wait for a condition only an ISR can make true; the ISR must call
+// PT_ISR_WAKE. No wake time is needed, so the idle scheduler sleeps
+// until the interrupt instead of polling the condition every msec
+#define PT_YIELD_UNTIL_IRQ(pt, cond) \
+    PT_YIELD_UNTIL(pt, (cond) || pt_note_wake(PT_GET_TIME() + PT_MAX_SLEEP_msec))
+
+// a thread that wakes more than PT_LATE_msec after the time it asked
+// for has missed its deadline -- charged to the thread being dispatched
+#define PT_LATE_msec 2
+#define PT_CHECK_DEADLINE(wake_time) \
+    if (pt_current != NULL && PT_GET_TIME() > (wake_time) + PT_LATE_msec) \
+        pt_current->missed++ ;
+
 // macro to return system time
-#define PT_GET_TIME() (time_tick_millsec)
+// milliseconds since PT_setup, brought up to date from the core timer
+#define PT_GET_TIME() (pt_update_time())
 
 // init rate sehcduler
 //#define PT_INIT(pt, priority)   LC_INIT((pt)->lc ; (pt)->pri = priority)
@@ -633,12 +653,134 @@ struct ptx {
 	int num;                    // thread number
 	char (*pf)(struct pt *pt); // pointer to thread function
     int rate;
+    // run time accounting, all times in core timer ticks (sys_clock/2)
+    unsigned int run_count;    // number of dispatches
+    unsigned int run_min;      // shortest dispatch
+    unsigned int run_max;      // longest dispatch
+    unsigned long long run_total; // sum of all dispatches, for the mean
+    unsigned int budget;       // longest allowed dispatch, zero for none
+    unsigned int overruns;     // dispatches longer than budget
+    unsigned int missed;       // late wakeups from PT_YIELD_TIME_msec
+    // what the thread asked for when it last ran; kept while the rate
+    // scheduler skips it
+    unsigned int wake;         // earliest time it wants to run again
+    int polls;                 // yielded without a wake time
 };
 
-// === extended structure for scheduler ===============
+// the thread currently being run by the scheduler, NULL outside of it
+static struct ptx *pt_current = NULL;
+
 // an array of task structures
 #define MAX_THREADS 10
 static struct ptx pt_thread_list[MAX_THREADS];
+
+// === tickless system time ===
+// The millisecond count is derived from the free-running core timer
+// whenever somebody asks for it, so there is no periodic tick interrupt.
+// pt_update_time must run at least once per core timer wrap (134 sec);
+// the scheduler calls it every pass and never sleeps longer than
+// PT_MAX_SLEEP_msec. Call it from thread level only, never from an ISR.
+#define PT_TICKS_PER_msec (sys_clock/2000)
+#define PT_MAX_SLEEP_msec 1000
+// system time in milliseconds
+volatile unsigned int time_tick_millsec ;
+// core timer count at which time_tick_millsec last advanced
+static unsigned int pt_time_base ;
+
+static unsigned int pt_update_time(void)
+{
+    unsigned int elapsed, msec ;
+    elapsed = ReadCoreTimer() - pt_time_base ;
+    if (elapsed >= PT_TICKS_PER_msec) {
+        msec = elapsed / PT_TICKS_PER_msec ;
+        time_tick_millsec += msec ;
+        pt_time_base += msec * PT_TICKS_PER_msec ;
+    }
+    return time_tick_millsec ;
+}
+
+// === idle scheduling ===
+// set to zero to keep the scheduler spinning (e.g. for the debugger)
+int pt_sched_idle = 1 ;
+// set when the thread being dispatched gave a wake time
+static int pt_wake_noted ;
+// set by ISRs that threads wait on with PT_YIELD_UNTIL_IRQ; an interrupt
+// after the thread looked but before the idle test must not be slept on
+volatile int pt_isr_wake ;
+#define PT_ISR_WAKE() (pt_isr_wake = 1)
+// core timer ticks spent in WAIT, out of all ticks since the last reset
+static unsigned long long pt_idle_ticks, pt_total_ticks ;
+static unsigned int pt_idle_last ;
+
+// record a thread's wake time; returns 0 so it can sit in a yield condition
+static int pt_note_wake(unsigned int wake_time)
+{
+    if (pt_current != NULL && wake_time < pt_current->wake) pt_current->wake = wake_time ;
+    pt_wake_noted = 1 ;
+    return 0 ;
+}
+
+// === sleep until the next thread is due ===
+// Called once per scheduler pass. The core timer compare is set to the
+// start of the millisecond in which the earliest thread wakes, and WAIT
+// is entered with interrupts masked so a compare (or any other interrupt)
+// that arrives after the test still ends the wait; its ISR then runs at
+// INTRestoreInterrupts, outside of the time counted as idle.
+// The wake times are those of every thread, not only the ones this pass
+// dispatched: a thread the rate scheduler skipped keeps its own, and
+// once that has gone by the passes follow each other without a sleep
+// until the thread's turn comes. Threads that poll a condition did not
+// give a wake time, so while there are any the sleep is cut to one
+// millisecond; the serial threads wait on DMA interrupts instead.
+static void pt_idle(void)
+{
+    unsigned int start, now, status, sleep_msec, wake_count, next_wake ;
+    int i, polling ;
+    next_wake = 0xffffffff ;
+    polling = 0 ;
+    for (i = 0; i < pt_task_count; i++) {
+        if (pt_thread_list[i].wake < next_wake) next_wake = pt_thread_list[i].wake ;
+        polling |= pt_thread_list[i].polls ;
+    }
+    now = PT_GET_TIME();
+    status = INTDisableInterrupts();
+    if (pt_sched_idle && !pt_isr_wake && now < next_wake) {
+        sleep_msec = next_wake - now ;
+        if (sleep_msec > PT_MAX_SLEEP_msec) sleep_msec = PT_MAX_SLEEP_msec ;
+        if (polling) sleep_msec = 1 ;
+        wake_count = pt_time_base + sleep_msec*PT_TICKS_PER_msec ;
+        _CP0_SET_COMPARE(wake_count);
+        start = ReadCoreTimer();
+        // the compare point may already have gone by
+        if ((int)(wake_count - start) > 0) {
+            asm volatile("wait");
+            pt_idle_ticks += ReadCoreTimer() - start ;
+        }
+    }
+    INTRestoreInterrupts(status);
+    // charge the whole pass to the total
+    now = ReadCoreTimer();
+    pt_total_ticks += now - pt_idle_last ;
+    pt_idle_last = now ;
+    pt_isr_wake = 0 ;
+}
+
+// percent of time the cpu spent asleep since the last PT_IDLE_RESET
+#define PT_IDLE_PERCENT() (pt_total_ticks ? (unsigned int)(pt_idle_ticks*100/pt_total_ticks) : 0)
+#define PT_IDLE_RESET() \
+do { pt_idle_ticks = 0; pt_total_ticks = 0; pt_idle_last = ReadCoreTimer(); } while(0)
+
+// core timer runs at half the cpu clock
+#define PT_TICKS_PER_usec (sys_clock/2000000)
+
+// === extended structure for scheduler ===============
+
+// clear the run time statistics of one thread (but not its budget)
+#define PT_STATS_RESET(thread_num) \
+do { struct ptx *p = &pt_thread_list[thread_num]; \
+    p->run_count = 0; p->run_min = 0xffffffff; p->run_max = 0; \
+    p->run_total = 0; p->overruns = 0; p->missed = 0; \
+} while(0)
 // see https://github.com/edartuz/c-ptx/tree/master/src
 // and the license above
 // add an entry to the thread list
@@ -653,6 +795,12 @@ int pt_add( char (*pf)(struct pt *pt), int rate) {
 		ptx->pf    = pf;
         // rate scheduler rate
         ptx->rate  = rate ; 
+        // no budget until PT_SET_BUDGET
+        ptx->budget = 0 ;
+        // due at the first pass
+        ptx->wake = 0 ;
+        ptx->polls = 0 ;
+        PT_STATS_RESET(pt_task_count) ;
 		PT_INIT( &ptx->pt );
         // count of number of defined threads
 		pt_task_count++;
@@ -697,6 +845,35 @@ int pt_sched_method = SCHED_ROUND_ROBIN ;
 #define PT_SET_RATE(thread_num, new_rate) pt_thread_list[thread_num].rate = new_rate
 #define PT_GET_RATE(thread_num) pt_thread_list[thread_num].rate 
 
+// per-thread time budget in microseconds; longer dispatches count as overruns
+#define PT_SET_BUDGET(thread_num, usec) pt_thread_list[thread_num].budget = (usec)*PT_TICKS_PER_usec
+// mean dispatch time in core timer ticks
+#define PT_GET_MEAN(thread_num) (pt_thread_list[thread_num].run_count ? \
+    (unsigned int)(pt_thread_list[thread_num].run_total/pt_thread_list[thread_num].run_count) : 0)
+
+// === dispatch one thread and charge its run time ===
+// Time spent in ISRs that preempt the thread is charged to the thread,
+// so run_max is an upper bound on the thread's own cost
+static void pt_dispatch(struct ptx *ptx)
+{
+    unsigned int start, elapsed ;
+    pt_current = ptx ;
+    pt_wake_noted = 0 ;
+    ptx->wake = 0xffffffff ;
+    start = ReadCoreTimer();
+    (ptx->pf)(&ptx->pt);
+    elapsed = ReadCoreTimer() - start ;
+    pt_current = NULL ;
+    // no wake time means the idle scheduler has to keep polling it
+    ptx->polls = !pt_wake_noted ;
+    
+    ptx->run_count++ ;
+    ptx->run_total += elapsed ;
+    if (elapsed < ptx->run_min) ptx->run_min = elapsed ;
+    if (elapsed > ptx->run_max) ptx->run_max = elapsed ;
+    if (ptx->budget > 0 && elapsed > ptx->budget) ptx->overruns++ ;
+}
+
 static PT_THREAD (protothread_sched(struct pt *pt))
 {   
     PT_BEGIN(pt);
@@ -704,6 +881,8 @@ static PT_THREAD (protothread_sched(struct pt *pt))
     PT_RATE_INIT()
     
     static int i, rate;
+    // start the idle percentage window
+    PT_IDLE_RESET();
     
     if (pt_sched_method==SCHED_ROUND_ROBIN){
         while(1) {
@@ -715,12 +894,14 @@ static PT_THREAD (protothread_sched(struct pt *pt))
           // -- separated using comma operator. But it can have only one condition.
           for (i=0; i<pt_task_count; i++, ptx++ ){
               // call thread function
-              (pt_thread_list[i].pf)(&ptx->pt); 
+              pt_dispatch(ptx); 
           }
           // copy data from target back to python
             if (UARTReceivedDataIsAvailable(UART1)){
                 UARTSendDataByte(UART2, UARTGetDataByte(UART1));
             }
+          // nothing due? sleep until the next interrupt
+          pt_idle();
           // Never yields! 
           // NEVER exit while!
         } // END WHILE(1)
@@ -744,9 +925,11 @@ static PT_THREAD (protothread_sched(struct pt *pt))
                 (rate==3 && ((pt_pri_count & 0b111)==0)) | 
                 (rate==4 && ((pt_pri_count & 0b1111)==0))){
                 // call thread function
-                    (pt_thread_list[i].pf)(&ptx->pt); 
+                    pt_dispatch(ptx); 
                 }
             }
+          // nothing due? sleep until the next interrupt
+          pt_idle();
           // Never yields! 
           // NEVER exit while!
         } // END WHILE(1)
@@ -863,9 +1046,6 @@ int PT_terminate_time = 0 ;
 // timeout return value
 int PT_timeout = 0; 
 
-// system time updated in TIMER1 ISR below
-volatile unsigned int time_tick_millsec ;
-
 int PT_GetMachineBuffer(struct pt *pt)
 {
     static char character;
@@ -876,7 +1056,7 @@ int PT_GetMachineBuffer(struct pt *pt)
     // actual number received
     num_char = 0;
     //record milliseconds for timeout calculation
-    start_time = time_tick_millsec ;
+    start_time = PT_GET_TIME() ;
     // clear timeout flag
     PT_timeout = 0;
     // clear input buffer
@@ -910,9 +1090,16 @@ int PT_GetMachineBuffer(struct pt *pt)
     }
     // === DMA event control ===============
     // trigger a byte  the UART  has data
-    DmaChnSetEventControl(DMA_CHANNEL0, DMA_EV_START_IRQ_EN|DMA_EV_MATCH_EN|DMA_EV_START_IRQ(_UART2_RX_IRQ));
+    // (no match for a count, binary data may hold any byte)
+    DmaChnSetEventControl(DMA_CHANNEL0, DMA_EV_START_IRQ_EN|DMA_EV_START_IRQ(_UART2_RX_IRQ)|
+                          (PT_terminate_char>0 ? DMA_EV_MATCH_EN : 0));
     // signal when done
     DmaChnSetEvEnableFlags(DMA_CHANNEL0, DMA_EV_BLOCK_DONE);
+    // the done flag of the last transfer is still set
+    DmaChnClrEvFlags(DMA_CHANNEL0, DMA_EV_BLOCK_DONE);
+    // its interrupt wakes the scheduler, see Dma0Handler
+    DmaChnClrIntFlag(DMA_CHANNEL0);
+    DmaChnIntEnable(DMA_CHANNEL0);
     // enable the channel
     DmaChnEnable(DMA_CHANNEL0);
   
@@ -920,12 +1107,14 @@ int PT_GetMachineBuffer(struct pt *pt)
     // yield until DMA done OR times out
     // are we using a terminate TIME
     PT_YIELD_UNTIL(pt, (DmaChnGetEvFlags(DMA_CHANNEL0) & DMA_EV_BLOCK_DONE) ||
-                       ((PT_terminate_time>0) && (time_tick_millsec >= PT_terminate_time+start_time)));
+                       ((PT_terminate_time>0)? PT_WAKE_AT(PT_terminate_time+start_time) :
+                           pt_note_wake(PT_GET_TIME() + PT_MAX_SLEEP_msec)));
+    DmaChnIntDisable(DMA_CHANNEL0);
     
     DmaChnDisable(DMA_CHANNEL0);
     
     // === check for timeout ========================
-    if((PT_terminate_time>0) && (time_tick_millsec >= PT_terminate_time+start_time)) {
+    if((PT_terminate_time>0) && (PT_GET_TIME() >= PT_terminate_time+start_time)) {
         // took too long so set the timeout flag
         PT_timeout = 1;
     }
@@ -955,6 +1144,23 @@ int PutSerialBuffer(struct pt *pt)
     PT_END(pt);
 }
 
+//====================================================================
+// === DMA channel 1 set up for strings ==============================
+// sends PT_send_buffer up to its terminating null
+void PT_DMA_string_setup(void)
+{
+  // configure the channel and enable end-on-match
+  DmaChnOpen(DMA_CHANNEL1, DMA_CHN_PRI2, DMA_OPEN_MATCH);
+  // trigger a byte everytime the UART is empty
+  DmaChnSetEventControl(DMA_CHANNEL1, DMA_EV_START_IRQ_EN|DMA_EV_MATCH_EN|DMA_EV_START_IRQ(_UART2_TX_IRQ));
+  // source and destination
+  DmaChnSetTxfer(DMA_CHANNEL1, PT_send_buffer+1, (void*)&U2TXREG, max_chars, 1, 1);
+  // signal when done
+  DmaChnSetEvEnableFlags(DMA_CHANNEL1, DMA_EV_BLOCK_DONE);
+  // set null as ending character (of a string)
+  DmaChnSetMatchPattern(DMA_CHANNEL1, 0x00);
+}
+
 //====================================================================
 // === DMA send string to the UART2 ==================================
 int PT_DMA_PutSerialBuffer(struct pt *pt)
@@ -967,11 +1173,50 @@ int PT_DMA_PutSerialBuffer(struct pt *pt)
     PT_YIELD_UNTIL(pt, UARTTransmitterIsReady(UART2));
     UARTSendDataByte(UART2, PT_send_buffer[0]);
     //DmaChnStartTxfer(DMA_CHANNEL1, DMA_WAIT_NOT, 0);
+    // the done flag of the last transfer is still set
+    DmaChnClrEvFlags(DMA_CHANNEL1, DMA_EV_BLOCK_DONE);
+    DmaChnClrIntFlag(DMA_CHANNEL1);
+    DmaChnIntEnable(DMA_CHANNEL1);
     // start the DMA
     DmaChnEnable(DMA_CHANNEL1);
     // wait for DMA done
     //mPORTBClearBits(BIT_0);
-    PT_YIELD_UNTIL(pt, DmaChnGetEvFlags(DMA_CHANNEL1) & DMA_EV_BLOCK_DONE);
+    PT_YIELD_UNTIL_IRQ(pt, DmaChnGetEvFlags(DMA_CHANNEL1) & DMA_EV_BLOCK_DONE);
+    DmaChnIntDisable(DMA_CHANNEL1);
+    //wait until the transmit buffer is empty
+    PT_YIELD_UNTIL(pt, U2STA&0x100);
+    
+    // kill this output thread, to allow spawning thread to execute
+    PT_EXIT(pt);
+    // and indicate the end of the thread
+    PT_END(pt);
+}
+
+//====================================================================
+// === DMA send binary data to the UART2 =============================
+// len bytes from buf, zeros included; buf must stay put until the
+// thread exits. Channel 1 is left set up for strings again.
+int PT_DMA_PutSerialBinary(struct pt *pt, const unsigned char *buf, int len)
+{
+    PT_BEGIN(pt);
+    if (len <= 0) PT_EXIT(pt);
+    // sent the first byte, the DMA follows on the UART empty event
+    PT_YIELD_UNTIL(pt, UARTTransmitterIsReady(UART2));
+    UARTSendDataByte(UART2, buf[0]);
+    if (len > 1) {
+        // a fixed count instead of end-on-match
+        DmaChnOpen(DMA_CHANNEL1, DMA_CHN_PRI2, DMA_OPEN_DEFAULT);
+        DmaChnSetEventControl(DMA_CHANNEL1, DMA_EV_START_IRQ_EN|DMA_EV_START_IRQ(_UART2_TX_IRQ));
+        DmaChnSetTxfer(DMA_CHANNEL1, buf+1, (void*)&U2TXREG, len-1, 1, 1);
+        DmaChnSetEvEnableFlags(DMA_CHANNEL1, DMA_EV_BLOCK_DONE);
+        DmaChnClrEvFlags(DMA_CHANNEL1, DMA_EV_BLOCK_DONE);
+        DmaChnClrIntFlag(DMA_CHANNEL1);
+        DmaChnIntEnable(DMA_CHANNEL1);
+        DmaChnEnable(DMA_CHANNEL1);
+        PT_YIELD_UNTIL_IRQ(pt, DmaChnGetEvFlags(DMA_CHANNEL1) & DMA_EV_BLOCK_DONE);
+        DmaChnIntDisable(DMA_CHANNEL1);
+        PT_DMA_string_setup();
+    }
     //wait until the transmit buffer is empty
     PT_YIELD_UNTIL(pt, U2STA&0x100);
     
@@ -987,18 +1232,31 @@ int PT_DMA_PutSerialBuffer(struct pt *pt)
 int CVRCON_setup ;
 
 
-// force full context save
-//int w;
-//void waste(void){w=1;};
-// Timer 1 interrupt handler ///////
-// ipl2 means "interrupt priority level 2"
-void __ISR(_TIMER_1_VECTOR, IPL2AUTO) Timer1Handler(void) //_TIMER_1_VECTOR
+// Core timer compare interrupt handler ///////
+// only there to end a WAIT in the scheduler when a thread is due;
+// ipl1 so it never delays the audio ISR at priority 2
+void __ISR(_CORE_TIMER_VECTOR, ipl1) CoreTimerHandler(void)
 {
     // clear the interrupt flag
-    mT1ClearIntFlag();
-    //count milliseconds
-    time_tick_millsec++ ;
-    //waste();
+    mCTClearIntFlag();
+}
+
+// DMA block done on the UART channels ///////
+// only there to end a WAIT for the serial thread waiting on it; the
+// channel's block done flag stays set for the thread to see, so its
+// interrupt goes off until the thread turns it on again
+void __ISR(_DMA_0_VECTOR, ipl1) Dma0Handler(void)
+{
+    DmaChnIntDisable(DMA_CHANNEL0);
+    DmaChnClrIntFlag(DMA_CHANNEL0);
+    PT_ISR_WAKE();
+}
+
+void __ISR(_DMA_1_VECTOR, ipl1) Dma1Handler(void)
+{
+    DmaChnIntDisable(DMA_CHANNEL1);
+    DmaChnClrIntFlag(DMA_CHANNEL1);
+    PT_ISR_WAKE();
 }
 
 void PT_setup (void)
@@ -1038,31 +1296,25 @@ void PT_setup (void)
   //normal_text ;
   
   // === set up DMA for UART output ==================
-  // configure the channel and enable end-on-match
-  DmaChnOpen(DMA_CHANNEL1, DMA_CHN_PRI2, DMA_OPEN_MATCH);
-  // trigger a byte everytime the UART is empty
-  DmaChnSetEventControl(DMA_CHANNEL1, DMA_EV_START_IRQ_EN|DMA_EV_MATCH_EN|DMA_EV_START_IRQ(_UART2_TX_IRQ));
-  // source and destination
-  DmaChnSetTxfer(DMA_CHANNEL1, PT_send_buffer+1, (void*)&U2TXREG, max_chars, 1, 1);
-  // signal when done
-  DmaChnSetEvEnableFlags(DMA_CHANNEL1, DMA_EV_BLOCK_DONE);
-  // set null as ending character (of a string)
-  DmaChnSetMatchPattern(DMA_CHANNEL1, 0x00);
+  PT_DMA_string_setup();
+  // block done interrupts, enabled while a thread waits on them
+  DmaChnSetIntPriority(DMA_CHANNEL0, 1, 0);
+  DmaChnSetIntPriority(DMA_CHANNEL1, 1, 0);
   
   
   //===================================================
   
 #endif //#ifdef use_uart_serial
   
-  // ===Set up timer1 ======================
-  // timer 1: on,  interrupts, internal clock, 
-  // set up to count millsec
-  OpenTimer1(T1_ON  | T1_SOURCE_INT | T1_PS_1_1 , pb_clock/1000);
-  // set up the timer interrupt with a priority of 2
-  ConfigIntTimer1(T1_INT_ON | T1_INT_PRIOR_2);
-  mT1ClearIntFlag(); // and clear the interrupt flag
-  // zero the system time tick
+  // ===Set up the tickless time base ======================
+  // zero the system time at the current core timer count
+  pt_time_base = ReadCoreTimer();
   time_tick_millsec = 0;
+  // core timer compare wakes the scheduler; pt_idle moves the compare point
+  OpenCoreTimer(PT_MAX_SLEEP_msec*PT_TICKS_PER_msec);
+  // set up the core timer interrupt with a priority of 1
+  mConfigIntCoreTimer(CT_INT_ON | CT_INT_PRIOR_1);
+  mCTClearIntFlag(); // and clear the interrupt flag
 
   //=== Set up VREF as a debugger output =======
   #ifdef use_vref_debug
@@ -0,0 +1,102 @@
+#include <string.h>
+#include "reverb.h"
+
+// a line too long for REVERB_RAM would not compile
+typedef char reverb_ram_fits[(REVERB_RAM <= REVERB_RAM_BUDGET)? 1 : -1];
+
+// comb feedback, the room size: RT60 of 1.0 to 1.5 s
+#define COMB_FEEDBACK 24904         // 0.76
+// share of the comb low-pass state kept each sample: the damping
+#define COMB_DAMP 9830              // 0.3
+// allpasses pass x - buf, store x + buf/2
+
+struct comb {
+    short *line;
+    int length, pos;
+    int lp;                         // feedback low-pass state
+};
+struct allpass {
+    short *line;
+    int length, pos;
+};
+
+static const int comb_lengths[REVERB_COMBS] = REVERB_COMB_LENGTHS;
+static const int allpass_lengths[2][2] = REVERB_ALLPASS_LENGTHS;
+// all the delay lines, one after the other
+static short lines[REVERB_RAM/2];
+static struct comb combs[REVERB_COMBS];
+static struct allpass allpasses[2][2];
+// send summed over the reverb sample, samples into it, and the last
+// two outputs of each ear, interpolated between
+static int send_sum, phase;
+static int prev[2], cur[2];
+
+static int sat16(int v)
+{
+    return (v > 32767)? 32767 : (v < -32768)? -32768 : v;
+}
+
+void reverb_init(void)
+{
+    short *p = lines;
+    int i, ear;
+    memset(lines, 0, sizeof(lines));
+    for (i = 0; i < REVERB_COMBS; i++) {
+        combs[i].line = p;
+        combs[i].length = comb_lengths[i];
+        combs[i].pos = combs[i].lp = 0;
+        p += comb_lengths[i];
+    }
+    for (ear = 0; ear < 2; ear++)
+        for (i = 0; i < 2; i++) {
+            allpasses[ear][i].line = p;
+            allpasses[ear][i].length = allpass_lengths[ear][i];
+            allpasses[ear][i].pos = 0;
+            p += allpass_lengths[ear][i];
+        }
+    send_sum = phase = 0;
+    prev[0] = prev[1] = cur[0] = cur[1] = 0;
+}
+
+static int comb_run(struct comb *c, int x)
+{
+    int y = c->line[c->pos];
+    c->lp = y + (((c->lp - y)*COMB_DAMP) >> 15);
+    c->line[c->pos] = sat16(x + ((c->lp*COMB_FEEDBACK) >> 15));
+    if (++c->pos == c->length) c->pos = 0;
+    return y;
+}
+
+static int allpass_run(struct allpass *a, int x)
+{
+    int b = a->line[a->pos];
+    a->line[a->pos] = sat16(x + (b >> 1));
+    if (++a->pos == a->length) a->pos = 0;
+    return b - x;
+}
+
+// one sample at the reverb rate, x the sum of REVERB_DECIMATE sends
+static void reverb_run(int x)
+{
+    int i, ear, y = 0;
+    // the average, and 1/REVERB_COMBS of it into each comb
+    x /= REVERB_DECIMATE*REVERB_COMBS;
+    for (i = 0; i < REVERB_COMBS; i++) y += comb_run(&combs[i], x);
+    for (ear = 0; ear < 2; ear++) {
+        prev[ear] = cur[ear];
+        cur[ear] = allpass_run(&allpasses[ear][1], allpass_run(&allpasses[ear][0], y));
+    }
+}
+
+void reverb_sample(int send, int out[2])
+{
+    int ear;
+    send_sum += send;
+    if (++phase == REVERB_DECIMATE) {
+        reverb_run(send_sum);
+        send_sum = phase = 0;
+    }
+    // back to DAC codes, a straight line from the last output to this one
+    for (ear = 0; ear < 2; ear++)
+        out[ear] = (prev[ear]*(REVERB_DECIMATE - phase) + cur[ear]*phase)/(REVERB_DECIMATE*16);
+}
@@ -0,0 +1,41 @@
+/*
+ * File:   reverb.h
+ * Street ambience: a shared stereo reverb fed by a mono send from every
+ * source
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef REVERB_H
+#define	REVERB_H
+/* A Schroeder reverb in the style of Freeverb: REVERB_COMBS comb filters
+ * in parallel, each with a one-pole low-pass in its feedback so the
+ * tail gets duller as it dies, then two allpasses per ear in series.
+ * The combs are shared; the ears have allpasses of different lengths,
+ * which is what makes them differ. Everything is integer, Q15
+ * coefficients, and the delay lines are 16 bit samples in 1/16 DAC
+ * codes, REVERB_RAM bytes in all.
+ *
+ * It runs at 1/REVERB_DECIMATE of the audio rate, about 6 kHz, on the
+ * average of the send over those samples, so the tail has nothing over
+ * 3 kHz, and the output is interpolated linearly back to the audio rate,
+ * one reverb sample late.
+ */
+
+#define REVERB_DECIMATE 4
+// delay lines, primes, at the reverb rate: 40 to 60 ms of combs
+#define REVERB_COMBS 4
+#define REVERB_COMB_LENGTHS {241, 281, 313, 359}
+#define REVERB_ALLPASS_LENGTHS {{73, 29}, {79, 23}}
+#define REVERB_RAM (2*(241 + 281 + 313 + 359 + 73 + 29 + 79 + 23))
+// what the 32 KB of the PIC32MX250 can spare for it
+#define REVERB_RAM_BUDGET 3072
+
+/* Empties the delay lines. */
+void reverb_init(void);
+
+/* One audio sample: the send of all sources, in 1/16 DAC codes, in;
+ * the tail of each ear, in DAC codes, out. Timer2 ISR only. */
+void reverb_sample(int send, int out[2]);
+
+#endif	/* REVERB_H */
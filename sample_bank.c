@@ -0,0 +1,6 @@
+// Generated by host/wav2adpcm.py -- do not edit
+#include <stddef.h>
+#include "adpcm.h"
+
+const struct adpcm_sample sample_bank[1] = {{NULL, 0, 0, 0}};
+const int sample_bank_len = 0;
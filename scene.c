@@ -0,0 +1,343 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tft_master.h"
+#include "tft_gfx.h"
+#include "serial_frame.h"
+#include "adpcm.h"
+#include "contour.h"
+#include "noise.h"
+#include "scene.h"
+
+// the chirp, ramp and tones voices all work out a float frequency and
+// DDS increment a sample
+const unsigned short scene_voice_cycles[VOICES] = {
+    0, 640, 640, 640, 80, 36, 28, 124
+};
+
+static float get_float(const unsigned char *p)
+{
+    unsigned int u = frame_get32(p);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static int get_s16(const unsigned char *p)
+{
+    return (short)frame_get16(p);
+}
+
+static int load_source(struct scene_source *s, const unsigned char *p, int version)
+{
+    struct scene_voice *v = &s->voice;
+    const unsigned char *vp = p + 4;
+    int i, params = (version >= 3)? 6 : 5;
+    v->type = p[0];
+    switch (v->type) {
+    case VOICE_NONE:
+        break;
+    case VOICE_CHIRP:
+        v->u.chirp.f0 = get_float(vp);
+        v->u.chirp.sweep = get_float(vp+4);
+        break;
+    case VOICE_RAMP:
+        v->u.ramp.period = (unsigned int)get_float(vp);
+        v->u.ramp.rise = get_float(vp+4);
+        v->u.ramp.rise0 = get_float(vp+8);
+        v->u.ramp.fall = get_float(vp+12);
+        v->u.ramp.fall0 = get_float(vp+16);
+        if (v->u.ramp.period < 2) return 0;
+        break;
+    case VOICE_TONES:
+        v->u.tones.f1 = get_float(vp);
+        v->u.tones.t1 = (unsigned int)get_float(vp+4);
+        v->u.tones.f2 = get_float(vp+8);
+        v->u.tones.t2 = (unsigned int)get_float(vp+12);
+        break;
+    case VOICE_SAMPLE:
+        i = (int)get_float(vp);
+        if (i < 0 || i >= sample_bank_len) return 0;
+        v->u.sample.sample = &sample_bank[i];
+        break;
+    case VOICE_NOISE:
+        v->u.noise.f_lo = get_float(vp);
+        v->u.noise.f_hi = get_float(vp+4);
+        v->u.noise.period = (unsigned int)get_float(vp+8);
+        v->u.noise.q = get_float(vp+12);
+        v->u.noise.band = get_float(vp+16) != 0;
+        // the resonance stays put in older blobs
+        v->u.noise.q_hi = (params > 5)? get_float(vp+20) : v->u.noise.q;
+        if (!(v->u.noise.f_lo > 0 && v->u.noise.f_lo <= NOISE_FC_MAX &&
+              v->u.noise.f_hi > 0 && v->u.noise.f_hi <= NOISE_FC_MAX &&
+              v->u.noise.q >= (float)NOISE_Q_MIN && v->u.noise.q_hi >= (float)NOISE_Q_MIN &&
+              v->u.noise.period >= 2)) return 0;
+        break;
+    case VOICE_FM:
+        v->u.fm.f = get_float(vp);
+        v->u.fm.ratio = get_float(vp+4);
+        v->u.fm.index0 = get_float(vp+8);
+        v->u.fm.index1 = get_float(vp+12);
+        v->u.fm.decay = (unsigned int)get_float(vp+16);
+        if (!(v->u.fm.f > 0 && v->u.fm.ratio > 0 && v->u.fm.decay > 0 &&
+              v->u.fm.index0 >= 0 && v->u.fm.index0 <= VOICE_FM_INDEX_MAX &&
+              v->u.fm.index1 >= 0 && v->u.fm.index1 <= VOICE_FM_INDEX_MAX)) return 0;
+        break;
+    case VOICE_CONTOUR:
+        i = (int)get_float(vp);
+        if (i < 0 || i >= contour_bank_len) return 0;
+        v->u.contour.voice = &contour_bank[i];
+        break;
+    default:
+        return 0;
+    }
+    p += 4 + 4*params;
+    s->x = get_s16(p);
+    s->y = get_s16(p+2);
+    s->atten_k = get_float(p+4);
+    s->atten_d0 = get_float(p+8);
+    s->atten_c = get_float(p+12);
+    s->max = get_float(p+16);
+    s->clamp = get_float(p+20);
+    s->threshold = get_float(p+24);
+    s->attack = frame_get32(p+28);
+    s->decay = frame_get32(p+32);
+    s->sustain = frame_get32(p+36);
+    s->length = frame_get32(p+40);
+    s->from_x = s->to_x = s->x;
+    s->from_y = s->to_y = s->y;
+    s->speed = 0;
+    if (version >= 2) {
+        s->to_x = get_s16(p+44);
+        s->to_y = get_s16(p+46);
+        s->speed = get_float(p+48);
+        if (!(s->speed >= 0)) return 0;
+    }
+    // the envelope slopes divide by attack and decay
+    return s->atten_d0 > 0 && s->attack > 0 && s->decay > 0 &&
+        s->clamp >= 0 && s->clamp <= 2047;
+}
+
+// 1 if a repeat of m covers x, y
+static int prim_covers(const struct scene_prim *m, int x, int y)
+{
+    int r, dx, dy, d0, d1, d2;
+    const short *v = m->v;
+    for (r = 0, dx = 0, dy = 0; r <= m->repeat; r++, dx += m->dx, dy += m->dy) {
+        switch (m->kind) {
+        case PRIM_RECT:
+            if (x >= v[0]+dx && x < v[0]+dx+v[2] && y >= v[1]+dy && y < v[1]+dy+v[3])
+                return 1;
+            break;
+        case PRIM_CIRCLE:
+            if ((x-v[0]-dx)*(x-v[0]-dx) + (y-v[1]-dy)*(y-v[1]-dy) <= v[2]*v[2])
+                return 1;
+            break;
+        case PRIM_TRIANGLE:
+            // on the same side of all three edges, either winding
+            d0 = (v[2]-v[0])*(y-v[1]-dy) - (v[3]-v[1])*(x-v[0]-dx);
+            d1 = (v[4]-v[2])*(y-v[3]-dy) - (v[5]-v[3])*(x-v[2]-dx);
+            d2 = (v[0]-v[4])*(y-v[5]-dy) - (v[1]-v[5])*(x-v[4]-dx);
+            if ((d0 >= 0 && d1 >= 0 && d2 >= 0) || (d0 <= 0 && d1 <= 0 && d2 <= 0))
+                return 1;
+            break;
+        }
+    }
+    return 0;
+}
+
+// the occlusion bitmap of the PRIM_OCCLUDE shapes
+static void scene_occupy(struct scene *t)
+{
+    const struct scene_prim *m;
+    int i, j, n;
+    memset(t->occ, 0, sizeof(t->occ));
+    for (m = t->prim; m < t->prim + t->prims; m++) {
+        if (!(m->flags & PRIM_OCCLUDE)) continue;
+        for (j = 0, n = 0; j < SCENE_OCC_H; j++)
+            for (i = 0; i < SCENE_OCC_W; i++, n++)
+                if (prim_covers(m, i*SCENE_OCC_CELL + SCENE_OCC_CELL/2,
+                        j*SCENE_OCC_CELL + SCENE_OCC_CELL/2))
+                    t->occ[n >> 3] |= 1 << (n & 7);
+    }
+}
+
+int scene_load(struct scene *sc, const unsigned char *blob, int len)
+{
+    struct scene *t = sc;
+    const unsigned char *p;
+    int length, i, version, source_size;
+
+    if (len < SCENE_HEADER || frame_get32(blob) != SCENE_MAGIC) return SCENE_BAD_HEADER;
+    // version 1 and 2 blobs still load: the sources of 1 stay put, the
+    // noise of both keeps one resonance
+    version = blob[4];
+    if (version < 1 || version > SCENE_VERSION) return SCENE_BAD_VERSION;
+    source_size = (version == 1)? SCENE_SOURCE_V1 :
+        (version == 2)? SCENE_SOURCE_V2 : SCENE_SOURCE;
+    t->sources = blob[5];
+    t->blocked = blob[6];
+    t->prims = blob[7];
+    if (t->sources > SCENE_SOURCES_MAX || t->blocked > SCENE_BLOCKED_MAX ||
+        t->prims > SCENE_PRIMS_MAX) return SCENE_BAD_COUNT;
+    length = frame_get16(blob+8);
+    if (length > len || length != SCENE_HEADER + SCENE_LISTENER +
+        t->blocked*SCENE_BLOCKED + t->sources*source_size + t->prims*SCENE_PRIM)
+        return SCENE_BAD_LENGTH;
+    if (frame_crc16(blob + SCENE_HEADER, length - SCENE_HEADER) != frame_get16(blob+10))
+        return SCENE_BAD_CRC;
+
+    p = blob + SCENE_HEADER;
+    t->start_x = get_s16(p);
+    t->start_y = get_s16(p+2);
+    t->min_x = get_s16(p+4);
+    t->min_y = get_s16(p+6);
+    t->max_x = get_s16(p+8);
+    t->max_y = get_s16(p+10);
+    t->step = frame_get16(p+12);
+    p += SCENE_LISTENER;
+    if (t->step == 0 || t->start_x < t->min_x || t->start_x > t->max_x ||
+        t->start_y < t->min_y || t->start_y > t->max_y) return SCENE_BAD_LISTENER;
+
+    for (i = 0; i < t->blocked; i++, p += SCENE_BLOCKED) {
+        t->block[i].x0 = get_s16(p);
+        t->block[i].y0 = get_s16(p+2);
+        t->block[i].x1 = get_s16(p+4);
+        t->block[i].y1 = get_s16(p+6);
+    }
+    memset(t->src, 0, sizeof(t->src));
+    for (i = 0; i < t->sources; i++, p += source_size)
+        if (!load_source(&t->src[i], p, version)) return SCENE_BAD_SOURCE;
+    for (i = 0; i < t->prims; i++, p += SCENE_PRIM) {
+        struct scene_prim *m = &t->prim[i];
+        int k;
+        m->kind = p[0];
+        m->flags = p[1];
+        m->repeat = p[2];
+        m->dx = (signed char)p[4];
+        m->dy = (signed char)p[5];
+        m->color = frame_get16(p+6);
+        for (k = 0; k < 6; k++) m->v[k] = get_s16(p + 8 + 2*k);
+        if (m->kind >= PRIMS) return SCENE_BAD_PRIM;
+    }
+    // the listener must start where it may walk
+    if (!scene_walkable(t, t->start_x, t->start_y)) return SCENE_BAD_LISTENER;
+    if (scene_isr_cycles(t) > SCENE_ISR_BUDGET) return SCENE_BAD_COST;
+    scene_occupy(t);
+    return SCENE_OK;
+}
+
+int scene_isr_cycles(const struct scene *sc)
+{
+    int i, cycles = SCENE_ISR_SHARED;
+    for (i = 0; i < sc->sources; i++) cycles += scene_voice_cycles[sc->src[i].voice.type];
+    return cycles;
+}
+
+void scene_draw(const struct scene *sc, int redraw)
+{
+    const struct scene_prim *m;
+    int r, dx, dy;
+    for (m = sc->prim; m < sc->prim + sc->prims; m++) {
+        if (redraw && !(m->flags & PRIM_REDRAW)) continue;
+        for (r = 0, dx = 0, dy = 0; r <= m->repeat; r++, dx += m->dx, dy += m->dy) {
+            switch (m->kind) {
+            case PRIM_RECT:
+                tft_fillRect(m->v[0]+dx, m->v[1]+dy, m->v[2], m->v[3], m->color);
+                break;
+            case PRIM_CIRCLE:
+                tft_fillCircle(m->v[0]+dx, m->v[1]+dy, m->v[2], m->color);
+                break;
+            case PRIM_TRIANGLE:
+                tft_fillTriangle(m->v[0]+dx, m->v[1]+dy, m->v[2]+dx, m->v[3]+dy,
+                    m->v[4]+dx, m->v[5]+dy, m->color);
+                break;
+            }
+        }
+    }
+}
+
+int scene_walkable(const struct scene *sc, int x, int y)
+{
+    int i;
+    if (x < sc->min_x || x > sc->max_x || y < sc->min_y || y > sc->max_y) return 0;
+    for (i = 0; i < sc->blocked; i++)
+        if (x >= sc->block[i].x0 && x <= sc->block[i].x1 &&
+            y >= sc->block[i].y0 && y <= sc->block[i].y1) return 0;
+    return 1;
+}
+
+// the occlusion cell of map coordinate v, off the map on its edge
+static int occ_cell(int v, int cells)
+{
+    v = (v < 0)? 0 : v/SCENE_OCC_CELL;
+    return (v < cells)? v : cells - 1;
+}
+
+int scene_ray(const struct scene *sc, int x0, int y0, int x1, int y1)
+{
+    int i = occ_cell(x0, SCENE_OCC_W), j = occ_cell(y0, SCENE_OCC_H);
+    int i1 = occ_cell(x1, SCENE_OCC_W), j1 = occ_cell(y1, SCENE_OCC_H);
+    int di = abs(i1 - i), dj = -abs(j1 - j), si = (i < i1)? 1 : -1, sj = (j < j1)? 1 : -1;
+    int err = di + dj, e2, n, count = 0;
+    // Bresenham from cell to cell
+    while (i != i1 || j != j1) {
+        e2 = 2*err;
+        if (e2 >= dj) { err += dj; i += si; }
+        if (e2 <= di) { err += di; j += sj; }
+        if (i == i1 && j == j1) break;
+        n = j*SCENE_OCC_W + i;
+        count += sc->occ[n >> 3] >> (n & 7) & 1;
+    }
+    return count;
+}
+
+/* The image across the wall at a = pos, from b = lo to hi, facing
+ * towards dir; a runs across the wall and b along it, la, lb is the
+ * listener and sa the source. 1 and the image's a in ia if both face
+ * the wall and the line from the listener to the image meets it. */
+static int wall_image(int pos, int lo, int hi, int dir, int la, int lb,
+    int sa, int sb, int *ia)
+{
+    float b;
+    if (dir*(la - pos) <= 0 || dir*(sa - pos) <= 0) return 0;
+    *ia = 2*pos - sa;
+    b = lb + (float)(pos - la)/(*ia - la)*(sb - lb);
+    return b >= lo && b <= hi;
+}
+
+// add an image to the list, nearest to lx, ly first, keeping max
+static void add_image(struct scene_point *img, int *n, int max, int x, int y,
+    int lx, int ly)
+{
+    long d = (long)(x - lx)*(x - lx) + (long)(y - ly)*(y - ly);
+    int i = (*n < max)? (*n)++ : max;
+    for (; i > 0; i--) {
+        const struct scene_point *p = &img[i - 1];
+        if ((long)(p->x - lx)*(p->x - lx) + (long)(p->y - ly)*(p->y - ly) <= d) break;
+        if (i < max) img[i] = *p;
+    }
+    if (i < max) {
+        img[i].x = x;
+        img[i].y = y;
+    }
+}
+
+int scene_reflections(const struct scene *sc, int lx, int ly, int sx, int sy,
+    struct scene_point *img, int max)
+{
+    const struct scene_prim *m;
+    int n = 0, r, x0, y0, x1, y1, ia;
+    for (m = sc->prim; m < sc->prim + sc->prims; m++) {
+        if (m->kind != PRIM_RECT || !(m->flags & PRIM_OCCLUDE)) continue;
+        for (r = 0, x0 = m->v[0], y0 = m->v[1]; r <= m->repeat; r++, x0 += m->dx, y0 += m->dy) {
+            x1 = x0 + m->v[2];
+            y1 = y0 + m->v[3];
+            // left, right, top and bottom walls
+            if (wall_image(x0, y0, y1, -1, lx, ly, sx, sy, &ia)) add_image(img, &n, max, ia, sy, lx, ly);
+            if (wall_image(x1, y0, y1, 1, lx, ly, sx, sy, &ia)) add_image(img, &n, max, ia, sy, lx, ly);
+            if (wall_image(y0, x0, x1, -1, ly, lx, sy, sx, &ia)) add_image(img, &n, max, sx, ia, lx, ly);
+            if (wall_image(y1, x0, x1, 1, ly, lx, sy, sx, &ia)) add_image(img, &n, max, sx, ia, lx, ly);
+        }
+    }
+    return n;
+}
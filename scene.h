@@ -0,0 +1,186 @@
+/*
+ * File:   scene.h
+ * Versioned binary scene description: sound sources, how they are
+ * synthesized and attenuated, and the map the listener walks on
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef SCENE_H
+#define	SCENE_H
+/* The blob is built on a PC by host/scene.py from a text description.
+ * One is compiled in as scene_default (scene_default.c, generated from
+ * host/collegetown.scene); others can be uploaded over the UART.
+ * All fields are little endian, floats are IEEE single precision.
+ *
+ *   header, 12 bytes
+ *     u32 magic      SCENE_MAGIC, "SCNE"
+ *     u8  version    SCENE_VERSION
+ *     u8  sources, blocked, prims
+ *     u16 length     of the whole blob
+ *     u16 crc        CRC-16/CCITT of everything after the header
+ *   listener, 14 bytes
+ *     s16 start x, y; min x, min y, max x, max y; u16 step
+ *   blocked rectangles the listener cannot enter, 8 bytes each
+ *     s16 x0, y0, x1, y1 (inclusive)
+ *   sources, 80 bytes each (76 in version 2, whose voices have only 5
+ *   parameters, and 68 in version 1, which has no path either)
+ *     u8  voice, 3 bytes padding
+ *     f32 voice parameters [6], see struct scene_voice
+ *     s16 x, y
+ *     f32 atten k, d0, c   attenuation k*log10(distance/d0) + c
+ *     f32 max, clamp       peak = max - attenuation, within 0..clamp
+ *     f32 threshold        amplitude when the note is over
+ *     u32 attack, decay, sustain, length   in samples
+ *     s16 to x, y; f32 speed   path: from x, y to here at speed pixels a
+ *                              second, then again from x, y; speed 0
+ *                              stays at x, y
+ *   map primitives, 20 bytes each, drawn in order
+ *     u8  kind, flags, repeat, padding   flags PRIM_REDRAW, PRIM_OCCLUDE
+ *     s8  dx, dy           offset of each repeat
+ *     u16 color            RGB565
+ *     s16 v[6]             rect x y w h, circle x y r, triangle x0..y2
+ */
+
+#define SCENE_MAGIC 0x454e4353
+#define SCENE_VERSION 3
+#define SCENE_HEADER 12
+#define SCENE_LISTENER 14
+#define SCENE_BLOCKED 8
+#define SCENE_SOURCE 80
+#define SCENE_SOURCE_V2 76
+#define SCENE_SOURCE_V1 68
+#define SCENE_PRIM 20
+
+// the engine has three far ear timers, one per source
+#define SCENE_SOURCES_MAX 3
+#define SCENE_BLOCKED_MAX 8
+#define SCENE_PRIMS_MAX 64
+#define SCENE_BLOB_MAX (SCENE_HEADER + SCENE_LISTENER + \
+    SCENE_BLOCKED_MAX*SCENE_BLOCKED + SCENE_SOURCES_MAX*SCENE_SOURCE + \
+    SCENE_PRIMS_MAX*SCENE_PRIM)
+
+// voices: how the audio ISR sets the frequency of a source from the
+// samples since its note started. Times are in samples of Timer2, about
+// 23988 a second. Noise, FM and contour frequencies are in Hz as heard;
+// chirp, ramp and tones ones are DDS units of the lab's Fs of 44000,
+// which the board plays at 23988/44000 of their value.
+enum { VOICE_NONE, VOICE_CHIRP, VOICE_RAMP, VOICE_TONES, VOICE_SAMPLE, VOICE_NOISE,
+       VOICE_FM, VOICE_CONTOUR, VOICES };
+// largest FM modulation index, in radians
+#define VOICE_FM_INDEX_MAX 20
+
+struct adpcm_sample;
+struct contour_voice;
+
+struct scene_voice {
+    int type;
+    union {
+        // f0 + sweep*t^2
+        struct { float f0, sweep; } chirp;
+        // t mod period: rise*t + rise0 the first half, fall*t + fall0 the second
+        struct { unsigned int period; float rise, rise0, fall, fall0; } ramp;
+        // f1 until t1, f2 until t2, then nothing
+        struct { float f1; unsigned int t1; float f2; unsigned int t2; } tones;
+        // a recording from sample_bank, by its number in the blob
+        struct { const struct adpcm_sample *sample; } sample;
+        // filtered noise, the cutoff from f_lo up to f_hi and back each
+        // period and the resonance with it from q to q_hi; the band-pass
+        // output if band, else the low-pass
+        struct { float f_lo, f_hi; unsigned int period; float q; int band; float q_hi; } noise;
+        // a sine at f Hz, its phase moved by index*sin of one at ratio*f;
+        // the index goes from index0 to index1 over the first decay samples
+        struct { float f, ratio, index0, index1; unsigned int decay; } fm;
+        // pitch and level breakpoints from contour_bank, by number
+        struct { const struct contour_voice *voice; } contour;
+    } u;
+};
+
+struct scene_source {
+    struct scene_voice voice;
+    int x, y;                       // where it is now, on its path
+    int from_x, from_y, to_x, to_y;
+    float speed;                    // pixels a second, 0 when it stays
+    float atten_k, atten_d0, atten_c;
+    float max, clamp, threshold;
+    unsigned int attack, decay, sustain, length;
+};
+
+// map primitives
+enum { PRIM_RECT, PRIM_CIRCLE, PRIM_TRIANGLE, PRIMS };
+// drawn again after the listener moves, over the trail of its dot
+#define PRIM_REDRAW 0x01
+// a building: blocks the sound between the listener and a source
+#define PRIM_OCCLUDE 0x02
+
+// the map the listener walks on, in pixels
+#define SCENE_MAP_W 240
+#define SCENE_MAP_H 320
+// occluding shapes as a bitmap of SCENE_OCC_CELL pixel cells, a bit
+// set where one covers the middle of a cell
+#define SCENE_OCC_CELL 8
+#define SCENE_OCC_W (SCENE_MAP_W/SCENE_OCC_CELL)
+#define SCENE_OCC_H (SCENE_MAP_H/SCENE_OCC_CELL)
+
+struct scene_prim {
+    unsigned char kind, flags, repeat;
+    signed char dx, dy;
+    unsigned short color;
+    short v[6];
+};
+
+struct scene_rect { short x0, y0, x1, y1; };
+struct scene_point { short x, y; };
+
+struct scene {
+    int sources, blocked, prims;
+    int start_x, start_y, min_x, min_y, max_x, max_y, step;
+    struct scene_rect block[SCENE_BLOCKED_MAX];
+    struct scene_source src[SCENE_SOURCES_MAX];
+    struct scene_prim prim[SCENE_PRIMS_MAX];
+    unsigned char occ[(SCENE_OCC_W*SCENE_OCC_H + 7)/8];
+};
+
+// scene_load results
+enum { SCENE_OK, SCENE_BAD_HEADER, SCENE_BAD_VERSION, SCENE_BAD_LENGTH,
+       SCENE_BAD_CRC, SCENE_BAD_COUNT, SCENE_BAD_LISTENER, SCENE_BAD_SOURCE,
+       SCENE_BAD_PRIM, SCENE_BAD_COST };
+
+/* The audio ISR's cost, estimated in cpu cycles a sample: what every
+ * sample costs, and what each source adds by the voice it plays, both
+ * ears. They are the totals of the table in host/host_sim.c, which
+ * host_sim -b checks them against. A scene that would take Timer2 past
+ * its period is refused with SCENE_BAD_COST. */
+#define SCENE_ISR_SHARED 1142
+#define SCENE_ISR_BUDGET 2667           // the Timer2 period, SAMPLE_PERIOD
+extern const unsigned short scene_voice_cycles[VOICES];
+int scene_isr_cycles(const struct scene *sc);
+
+// the scene compiled into flash
+extern const unsigned char scene_default[];
+extern const int scene_default_len;
+
+/* Checks a blob and unpacks it into sc, which is left half written if
+ * the blob is bad: load into a scene nothing plays from. Returns
+ * SCENE_OK or what is wrong with it. */
+int scene_load(struct scene *sc, const unsigned char *blob, int len);
+
+/* Draws the map; with redraw set only the PRIM_REDRAW primitives. */
+void scene_draw(const struct scene *sc, int redraw);
+
+/* 1 if the listener may stand at x, y. */
+int scene_walkable(const struct scene *sc, int x, int y);
+
+/* Occluded cells on the straight line from x0, y0 to x1, y1, not
+ * counting the cells at either end. */
+int scene_ray(const struct scene *sc, int x0, int y0, int x1, int y1);
+
+/* First order reflections of a sound at sx, sy heard at lx, ly off the
+ * walls of the PRIM_OCCLUDE rectangles: the images of the source in the
+ * walls it and the listener both face, where the reflection point lies
+ * on the wall. At most max of them into img, the nearest first; returns
+ * how many. */
+int scene_reflections(const struct scene *sc, int lx, int ly, int sx, int sy,
+    struct scene_point *img, int max);
+
+#endif	/* SCENE_H */
@@ -0,0 +1,93 @@
+// Generated by host/scene.py from collegetown.scene -- do not edit
+#include "scene.h"
+
+const unsigned char scene_default[] = {
+    0x53, 0x43, 0x4e, 0x45, 0x03, 0x03, 0x01, 0x26, 0x0a, 0x04, 0xb2, 0xe6,
+    0x78, 0x00, 0x36, 0x01, 0x5a, 0x00, 0x0a, 0x00, 0x96, 0x00, 0x36, 0x01,
+    0x0a, 0x00, 0x79, 0x00, 0x00, 0x00, 0x9f, 0x00, 0x31, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xfa, 0x44, 0xa0, 0x6e, 0x20, 0x39, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x50, 0x00, 0x78, 0x00, 0x00, 0x00, 0x20, 0x41, 0x00, 0x00,
+    0xc0, 0x40, 0x00, 0x00, 0x00, 0xc0, 0x00, 0x00, 0x40, 0x41, 0x00, 0x00,
+    0x40, 0x41, 0x00, 0x00, 0x00, 0x00, 0xe8, 0x03, 0x00, 0x00, 0xe8, 0x03,
+    0x00, 0x00, 0x88, 0x0e, 0x00, 0x00, 0xa0, 0x86, 0x01, 0x00, 0x50, 0x00,
+    0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xa0, 0x42, 0x00, 0x00, 0xc8, 0x43, 0x00, 0x80, 0x32, 0x44, 0x00, 0x00,
+    0xc0, 0x3f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0x3f, 0x8e, 0x00,
+    0x19, 0x00, 0x00, 0x00, 0x16, 0x43, 0x00, 0x00, 0xa0, 0x41, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x34, 0x43, 0x00, 0x00, 0x34, 0x43, 0x00, 0x00,
+    0x00, 0x00, 0x94, 0x05, 0x00, 0x00, 0x94, 0x05, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x28, 0x0b, 0x00, 0x00, 0x8e, 0x00, 0x19, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x02, 0x45, 0x33, 0x33,
+    0xb3, 0x3f, 0x00, 0x00, 0x00, 0x41, 0x00, 0x00, 0x80, 0x3f, 0x00, 0x80,
+    0x3b, 0x46, 0x00, 0x00, 0x00, 0x00, 0xb7, 0x00, 0xdd, 0x00, 0x00, 0x00,
+    0x70, 0x41, 0x00, 0x00, 0xc0, 0x40, 0x00, 0x00, 0x80, 0xbf, 0x00, 0x00,
+    0x90, 0x41, 0x00, 0x00, 0x90, 0x41, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x07,
+    0x00, 0x00, 0x70, 0x17, 0x00, 0x00, 0x10, 0x27, 0x00, 0x00, 0x70, 0x11,
+    0x01, 0x00, 0xb7, 0x00, 0xdd, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0x00, 0x00, 0x00, 0x00, 0x50, 0x00,
+    0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0xd3, 0x9c, 0xa0, 0x00, 0x00, 0x00, 0x50, 0x00, 0x78, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0x00, 0x00,
+    0xc8, 0x00, 0x50, 0x00, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0xa0, 0x00, 0xc8, 0x00, 0x50, 0x00,
+    0x78, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x50, 0x00, 0x00, 0x00, 0x50, 0x00, 0x40, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x78, 0x00, 0xf0, 0x00, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x07, 0x00, 0x0a, 0x00, 0xff, 0xff, 0x52, 0x00, 0x64, 0x00, 0x05, 0x00,
+    0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x07, 0x00, 0x0a, 0x00,
+    0xff, 0xff, 0x52, 0x00, 0xc8, 0x00, 0x05, 0x00, 0x14, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x07, 0x00, 0x00, 0x0a, 0xff, 0xff, 0x3c, 0x00,
+    0x7a, 0x00, 0x14, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x07, 0x00, 0x00, 0x0a, 0xff, 0xff, 0xa0, 0x00, 0x7a, 0x00, 0x14, 0x00,
+    0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0xe0, 0x07, 0x78, 0x00, 0x70, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0xa8, 0x00,
+    0xa0, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x40, 0xeb, 0x28, 0x00, 0x8c, 0x00, 0x28, 0x00,
+    0xb4, 0x00, 0x4b, 0x00, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x2b, 0x00, 0x9e, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x32, 0x00,
+    0x9e, 0x00, 0x12, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xe0, 0x90, 0xa5, 0x00, 0xd8, 0x00, 0x05, 0x00,
+    0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xe0, 0x90, 0xb7, 0x00, 0xde, 0x00, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0xb7, 0x00,
+    0xc8, 0x00, 0x10, 0x00, 0xfa, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xb7, 0x00, 0xde, 0x00, 0x08, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xe0, 0x90, 0xb3, 0x00, 0xd6, 0x00, 0x04, 0x00, 0x12, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe0, 0x90, 0xaf, 0x00,
+    0xd8, 0x00, 0x04, 0x00, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xf8, 0x82, 0x00, 0x19, 0x00, 0x14, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x6e, 0x00, 0x05, 0x00, 0x14, 0x00, 0x32, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00,
+    0x05, 0x00, 0x0a, 0x00, 0x32, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0x8e, 0x00, 0x19, 0x00, 0x0c, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xf8, 0x82, 0x00, 0x0a, 0x00, 0x0e, 0x00, 0x1e, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0x82, 0x00,
+    0x0f, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xd3, 0x9c, 0x82, 0x00, 0x23, 0x00, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x09, 0x00, 0x00, 0x0a,
+    0xff, 0xff, 0x77, 0x00, 0x00, 0x00, 0x02, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x09, 0x00, 0x00, 0x0a, 0xff, 0xff, 0x77, 0x00,
+    0xe1, 0x00, 0x02, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x05, 0x00, 0x0a, 0x00, 0xff, 0xff, 0x00, 0x00, 0x9f, 0x00, 0x05, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x0a, 0x00,
+    0xff, 0xff, 0xb9, 0x00, 0x9f, 0x00, 0x05, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0xeb, 0x28, 0x00,
+    0x8c, 0x00, 0x28, 0x00, 0xb4, 0x00, 0x4b, 0x00, 0xa0, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2b, 0x00, 0x9e, 0x00, 0x04, 0x00,
+    0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x32, 0x00, 0x9e, 0x00, 0x12, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x9b, 0x3d, 0x00,
+    0x6d, 0x00, 0x43, 0x00, 0x6c, 0x00, 0x40, 0x00, 0x74, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xe0, 0xff, 0x40, 0x00, 0x66, 0x00, 0x07, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x41, 0x00, 0x65, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00,
+};
+const int scene_default_len = sizeof(scene_default);
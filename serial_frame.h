@@ -0,0 +1,102 @@
+/*
+ * File:   serial_frame.h
+ * Binary frames on the UART: sync, header, payload and CRC
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef SERIAL_FRAME_H
+#define	SERIAL_FRAME_H
+/* A frame on the wire, multi-byte fields little endian:
+ *   0xA5 0x5A  sync
+ *   type       what the payload is, FRAME_*
+ *   seq        counts frames of each sender, a gap means a lost frame
+ *   len        payload bytes
+ *   payload
+ *   crc        CRC-16/CCITT (poly 0x1021, init 0xffff) of type..payload
+ * The receiver hunts for the sync bytes and drops anything whose CRC
+ * fails, so it can start listening mid-stream and lines of text
+ * printed on the same UART are skipped.
+ */
+
+#define FRAME_SYNC0 0xa5
+#define FRAME_SYNC1 0x5a
+// sync, type, seq, len and the CRC
+#define FRAME_OVERHEAD 7
+#define FRAME_PAYLOAD_MAX 160
+
+// frame types
+#define FRAME_TELEMETRY 0x01     // firmware -> host
+#define FRAME_COMMAND 0x02       // host -> firmware
+#define FRAME_ACK 0x03           // firmware -> host, answers a command
+#define FRAME_SCENE 0x04         // host -> firmware, part of a scene blob
+#define FRAME_INPUT 0x05         // both ways, part of an input trace
+
+struct frame {
+    int len;                    // bytes in buf so far
+    unsigned char buf[FRAME_OVERHEAD + FRAME_PAYLOAD_MAX];
+};
+
+// bitwise, about 60 instructions a byte; the frames are short and rare
+static inline unsigned int frame_crc16(const unsigned char *p, int n)
+{
+    unsigned int crc = 0xffff;
+    int bit;
+    while (n-- > 0) {
+        crc ^= (unsigned int)*p++ << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc & 0xffff;
+}
+
+static inline void frame_begin(struct frame *f, int type, int seq)
+{
+    f->buf[0] = FRAME_SYNC0;
+    f->buf[1] = FRAME_SYNC1;
+    f->buf[2] = type;
+    f->buf[3] = seq;
+    f->len = 5;
+}
+
+// append payload fields; whatever does not fit is dropped
+static inline void frame_put8(struct frame *f, unsigned int v)
+{
+    if (f->len < FRAME_OVERHEAD - 2 + FRAME_PAYLOAD_MAX) f->buf[f->len++] = v;
+}
+
+static inline void frame_put16(struct frame *f, unsigned int v)
+{
+    frame_put8(f, v);
+    frame_put8(f, v >> 8);
+}
+
+static inline void frame_put32(struct frame *f, unsigned int v)
+{
+    frame_put16(f, v);
+    frame_put16(f, v >> 16);
+}
+
+// read payload fields
+static inline unsigned int frame_get16(const unsigned char *p)
+{
+    return p[0] | (unsigned int)p[1] << 8;
+}
+
+static inline unsigned int frame_get32(const unsigned char *p)
+{
+    return frame_get16(p) | frame_get16(p+2) << 16;
+}
+
+// fill in the length and CRC; returns the bytes to send
+static inline int frame_end(struct frame *f)
+{
+    unsigned int crc;
+    f->buf[4] = f->len - 5;
+    crc = frame_crc16(f->buf + 2, f->len - 2);
+    f->buf[f->len++] = crc;
+    f->buf[f->len++] = crc >> 8;
+    return f->len;
+}
+
+#endif	/* SERIAL_FRAME_H */
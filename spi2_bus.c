@@ -0,0 +1,95 @@
+#include "spi2_bus.h"
+#include "spsc_queue.h"
+
+// transactions waiting for the audio ISR; the queue carries slot numbers
+#define SPI2_QUEUE_SIZE 4
+SPSC_QUEUE(spi2_queue, SPI2_QUEUE_SIZE);
+static struct spi2_xfer *spi2_slot[SPI2_QUEUE_SIZE];
+
+// === spi bit widths ====================================================
+// hit the SPI control register directly, SPI2
+// Change the SPI bit modes on the fly, mid-transaction if necessary
+inline void SPI_Mode16(void){  // configure SPI2 for 16-bit mode
+    SPI2CONSET = 0x400;
+    SPI2CONCLR = 0x800;
+}
+// ========
+inline void SPI_Mode8(void){  // configure SPI2 for 8-bit mode
+    SPI2CONCLR = 0x400;
+    SPI2CONCLR = 0x800;
+}
+// ========
+inline void SPI_Mode32(void){  // configure SPI2 for 32-bit mode
+    SPI2CONCLR = 0x400;
+    SPI2CONSET = 0x800;
+}
+
+void spi2_bus_init(void) {
+  // SDO2 (MOSI) is in PPS output group 2, could be connected to RB5 which is pin 14
+  PPSOutput(2, RPB5, SDO2);
+  // 16 bit transfer CKP=1 CKE=1, clk divider set to 4
+  SpiChnOpen(SPI_CHANNEL2, SPI_OPEN_ON | SPI_OPEN_MODE16 | SPI_OPEN_MSTEN | SPI_OPEN_CKE_REV, SPI2_CLK_DIV);
+}
+
+// the audio ISR owns the bus while Timer2 and its interrupt are on
+static int spi2_dac_running(void) {
+  return T2CONbits.ON && IEC0bits.T2IE;
+}
+
+// clock one transaction out, then back to 16-bit for the DAC
+// multiples of 4 bytes go as 32-bit words, MSB first, so there is only
+// one wait per word instead of one per byte
+static void spi2_xfer_now(struct spi2_xfer *x) {
+  int i;
+  unsigned int word;
+  mPORTBClearBits(x->cs);
+  if ((x->len & 3) == 0) {
+    SPI_Mode32();
+    for (i = 0; i < x->len; i += 4) {
+      WriteSPI2(((unsigned int)x->tx[i] << 24) | ((unsigned int)x->tx[i+1] << 16) |
+                ((unsigned int)x->tx[i+2] << 8) | x->tx[i+3]);
+      while (SPI2STATbits.SPIBUSY); // wait for word to be sent
+      word = ReadSPI2();
+      x->rx[i] = word >> 24;
+      x->rx[i+1] = word >> 16;
+      x->rx[i+2] = word >> 8;
+      x->rx[i+3] = word;
+    }
+  }
+  else {
+    SPI_Mode8();
+    for (i = 0; i < x->len; i++) {
+      WriteSPI2(x->tx[i]);
+      while (SPI2STATbits.SPIBUSY); // wait for byte to be sent
+      x->rx[i] = ReadSPI2();
+    }
+  }
+  mPORTBSetBits(x->cs);
+  SPI_Mode16();
+  x->done = 1;
+}
+
+void spi2_run(struct spi2_xfer *x) {
+  unsigned int item;
+  x->done = 0;
+  // the audio ISR has no time for more
+  if (x->len > SPI2_XFER_MAX) x->len = SPI2_XFER_MAX;
+  if (spi2_dac_running()) {
+    // wait for room, then for the audio ISR to get to it
+    while (spsc_count(&spi2_queue) >= SPI2_QUEUE_SIZE);
+    item = spi2_queue.head & (SPI2_QUEUE_SIZE-1);
+    spi2_slot[item] = x;
+    spsc_put(&spi2_queue, item);
+    while (!x->done);
+  }
+  else {
+    // finish anything queued before the audio stopped, in order
+    while (spsc_get(&spi2_queue, &item)) spi2_xfer_now(spi2_slot[item]);
+    spi2_xfer_now(x);
+  }
+}
+
+void spi2_service(void) {
+  unsigned int item;
+  if (spsc_get(&spi2_queue, &item)) spi2_xfer_now(spi2_slot[item]);
+}
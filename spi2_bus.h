@@ -0,0 +1,66 @@
+/*
+ * File:   spi2_bus.h
+ * SPI2 transaction manager for the DAC and the MCP23S17 port expander
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef SPI2_BUS_H
+#define	SPI2_BUS_H
+/* SPI2 is shared by the DAC, written from the audio ISR every sample, and
+ * the port expander, used from threads. Instead of locking the audio ISR
+ * out while the expander talks, expander transactions are queued and the
+ * audio ISR clocks one of them out in the idle gap after each DAC word
+ * pair (spi2_service). When the audio timer is off there is nobody to
+ * share with and transactions run directly.
+ *
+ * A transaction cannot be spread over several samples: its chip select
+ * would be low while the DAC words go out on the same clock. So the
+ * audio ISR waits on every word of it, and the longest one has to fit
+ * the slack the ISR leaves in its sample period. SPI2_XFER_CYCLES is a
+ * bound on it, every byte a word of its own, and must stay within
+ * SPI2_SERVICE_BUDGET; host_sim -b counts it with the rest of the ISR.
+ * A thread in spi2_run waits at most SPI2_QUEUE_SIZE samples.
+ *
+ * Between transactions SPI2 is always left in 16-bit mode for the DAC.
+ */
+#include "plib.h"
+
+// SPI2 clock divider: pb_clock/4
+#define SPI2_CLK_DIV 4
+// longest single transaction, in bytes
+#define SPI2_XFER_MAX 8
+// pb clocks to switch modes, load, wait on and read one word
+#define SPI2_WORD_OVERHEAD 12
+#define SPI2_XFER_CYCLES (SPI2_XFER_MAX*(8*SPI2_CLK_DIV + SPI2_WORD_OVERHEAD))
+// of the audio ISR's sample period, for spi2_service
+#define SPI2_SERVICE_BUDGET 400
+typedef char spi2_xfer_fits_budget[(SPI2_XFER_CYCLES <= SPI2_SERVICE_BUDGET)? 1 : -1];
+
+struct spi2_xfer {
+    unsigned int cs;                 // PORTB bit of the chip select (active low)
+    unsigned char len;               // bytes to clock
+    unsigned char tx[SPI2_XFER_MAX]; // bytes sent
+    unsigned char rx[SPI2_XFER_MAX]; // bytes received at the same time
+    volatile unsigned char done;     // set when rx is valid
+};
+
+/* Opens SPI2 in 16-bit master mode, clock = pb_clock/4. Safe to call
+ * more than once. */
+void spi2_bus_init(void);
+
+/* Runs one transaction and returns when it is done. Thread level only:
+ * there must be a single context submitting transactions. Anything
+ * past SPI2_XFER_MAX bytes is not sent. */
+void spi2_run(struct spi2_xfer *);
+
+/* Clocks out at most one queued transaction. Called by the audio ISR
+ * right after its DAC words, with the DAC chip select already high. */
+void spi2_service(void);
+
+// change the SPI2 word width on the fly
+inline void SPI_Mode16(void);
+inline void SPI_Mode8(void);
+inline void SPI_Mode32(void);
+
+#endif	/* SPI2_BUS_H */
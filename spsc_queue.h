@@ -0,0 +1,75 @@
+/*
+ * File:   spsc_queue.h
+ * Lock-free single-producer/single-consumer queues and double-buffered
+ * parameter blocks for passing data between ISRs and protothreads
+ *
+ * Created on October 18, 2026
+ */
+
+#ifndef SPSC_QUEUE_H
+#define	SPSC_QUEUE_H
+#include <string.h>
+
+// The PIC32MX M4K core issues loads and stores in program order and has
+// no data cache in front of SRAM, so an ISR sees stores in the order the
+// code makes them. Only the compiler can reorder them; this stops it.
+#define SPSC_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// === queue of 32-bit words ==============================================
+// head is only written by the producer and tail only by the consumer,
+// so no lock is needed as long as each side runs in one context
+// (one thread, or ISRs of one priority level that cannot preempt each other)
+struct spsc_queue {
+    volatile unsigned int head; // next slot to write
+    volatile unsigned int tail; // next slot to read
+    unsigned int mask;          // size-1, size MUST be a power of two
+    unsigned int *buf;
+};
+
+// define a queue and its storage
+#define SPSC_QUEUE(name, size) \
+    static unsigned int name##_buf[size]; \
+    struct spsc_queue name = {0, 0, (size)-1, name##_buf}
+
+// number of items waiting
+#define spsc_count(q) ((q)->head - (q)->tail)
+
+// add an item; returns 0 (and drops the item) if the queue is full
+static inline int spsc_put(struct spsc_queue *q, unsigned int item)
+{
+    unsigned int head = q->head;
+    if (head - q->tail > q->mask) return 0;
+    q->buf[head & q->mask] = item;
+    // the item must be in the buffer before the consumer can see it
+    SPSC_BARRIER();
+    q->head = head + 1;
+    return 1;
+}
+
+// take an item; returns 0 if the queue is empty
+static inline int spsc_get(struct spsc_queue *q, unsigned int *item)
+{
+    unsigned int tail = q->tail;
+    if (tail == q->head) return 0;
+    *item = q->buf[tail & q->mask];
+    // the slot must be read before the producer may reuse it
+    SPSC_BARRIER();
+    q->tail = tail + 1;
+    return 1;
+}
+
+// === double-buffered parameter block ===================================
+// The writer edits the back copy and publishes it with a single word
+// store, so a reader always sees one complete parameter set. The reader
+// must not be preempted by the writer while it uses the front copy,
+// which holds for an ISR reading a block written by a thread.
+#define DBUF(type) struct { type buf[2]; volatile unsigned int front; }
+#define DBUF_FRONT(d) (&(d).buf[(d).front])
+#define DBUF_BACK(d)  (&(d).buf[(d).front ^ 1])
+// start an edit from a copy of the current front; returns the back copy
+#define DBUF_EDIT(d) \
+    (memcpy(DBUF_BACK(d), DBUF_FRONT(d), sizeof((d).buf[0])), DBUF_BACK(d))
+// make the back copy the front
+#define DBUF_PUBLISH(d) do { SPSC_BARRIER(); (d).front ^= 1; } while(0)
+
+#endif	/* SPSC_QUEUE_H */